@@ -0,0 +1,108 @@
+#    NXLightSwitch for Nintendo Switch
+#    Made with love by Jonathan Verbeek (jverbeek.de)
+
+#---------------------------------------------------------------------------------
+#	Turns an NXLightSwitch.ini into baked_config.h for BAKED_CONFIG builds.
+#	Only the [NXLightSwitch] section is read, keys are case insensitive. Keys
+#	which need the SD card (ReloadTime, Trace, RecordInputs) are left out, as
+#	baked builds don't mount it.
+#---------------------------------------------------------------------------------
+
+function trim(s) {
+	sub(/^[ \t\r]+/, "", s)
+	sub(/[ \t\r]+$/, "", s)
+	return s
+}
+
+# Whether an ini value means true
+function is_true(s) {
+	s = tolower(s)
+	return s == "true" || s == "yes" || s == "on" || s == "1"
+}
+
+# Whether s is a valid HH:MM time of day
+function is_time(s) {
+	if (s !~ /^[0-9]?[0-9]:[0-9][0-9]$/)
+		return 0
+	split(s, parts, ":")
+	return parts[1] + 0 < 24 && parts[2] + 0 < 60
+}
+
+# Prints "hour, minute" of a HH:MM time, or the fallback if there is none
+function time_of(s, fallback) {
+	if (s == "" || s == "0")
+		return fallback
+	split(s, parts, ":")
+	return (parts[1] + 0) ", " (parts[2] + 0)
+}
+
+# Fails the build on a time which isn't one, rather than baking in a schedule
+# that never triggers
+function check_time(key, name) {
+	if (values[key] == "" || values[key] == "0" || is_time(values[key]))
+		return 1
+	printf "%s: invalid %s \"%s\", expected HH:MM\n", FILENAME, name, values[key] > "/dev/stderr"
+	return 0
+}
+
+BEGIN {
+	section = ""
+	values["lighttime"] = "0"
+	values["darktime"] = "0"
+	values["lightbrightness"] = "-1"
+	values["darkbrightness"] = "-1"
+	values["ambientlight"] = "false"
+	values["ambientlightthreshold"] = "20"
+	values["ambientlighthysteresis"] = "0.25"
+}
+
+/^[ \t]*[;#]/ { next }
+
+/^[ \t]*\[/ {
+	section = tolower(trim($0))
+	gsub(/[\[\]]/, "", section)
+	next
+}
+
+section == "nxlightswitch" && index($0, "=") > 0 {
+	key = tolower(trim(substr($0, 1, index($0, "=") - 1)))
+	value = substr($0, index($0, "=") + 1)
+	sub(/[ \t];.*$/, "", value)
+	values[key] = trim(value)
+}
+
+END {
+	# Check everything before printing, so a bad config leaves no header behind
+	valid = check_time("lighttime", "LightTime")
+	valid = check_time("darktime", "DarkTime") && valid
+	if (!valid)
+		exit 1
+
+	print "// Generated from " FILENAME " by bake_config.awk, do not edit"
+	print "#pragma once"
+	print ""
+	print "namespace nxlightswitch"
+	print "{"
+	print "    // Schedule compiled into BAKED_CONFIG builds, in place of the config file"
+	print "    struct BakedConfig"
+	print "    {"
+	print "        int lightHour, lightMinute;"
+	print "        int darkHour, darkMinute;"
+	print "        float lightBrightness;"
+	print "        float darkBrightness;"
+	print "        bool ambientLight;"
+	print "        float ambientLightThreshold;"
+	print "        float ambientLightHysteresis;"
+	print "    };"
+	print ""
+	print "    constexpr BakedConfig BakedConfigValues = {"
+	print "        " time_of(values["lighttime"], "0, 0") ","
+	print "        " time_of(values["darktime"], "0, 0") ","
+	printf "        %.3ff,\n", values["lightbrightness"] + 0
+	printf "        %.3ff,\n", values["darkbrightness"] + 0
+	print "        " (is_true(values["ambientlight"]) ? "true" : "false") ","
+	printf "        %.3ff,\n", values["ambientlightthreshold"] + 0
+	printf "        %.3ff\n", values["ambientlighthysteresis"] + 0
+	print "    };"
+	print "}"
+}
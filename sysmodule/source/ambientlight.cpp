@@ -0,0 +1,63 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "ambientlight.hpp"
+#include <algorithm>
+#include <cmath>
+using namespace nxlightswitch;
+
+AmbientLightFilter::AmbientLightFilter()
+{
+    Configure(AMBIENT_LIGHT_DEFAULT_THRESHOLD, AMBIENT_LIGHT_DEFAULT_HYSTERESIS);
+}
+
+void AmbientLightFilter::Configure(float threshold, float hysteresis)
+{
+    this->threshold = std::max(threshold, 0.0f);
+    this->hysteresis = std::min(std::max(hysteresis, 0.0f), 1.0f);
+    hasTheme = false;
+    theme = ColorSetId_Light;
+    average = 0.0f;
+    interval = AMBIENT_LIGHT_MIN_INTERVAL;
+}
+
+bool AmbientLightFilter::AddReading(float lux)
+{
+    lux = std::max(lux, 0.0f);
+    float lowerEdge = threshold * (1.0f - hysteresis);
+    float upperEdge = threshold * (1.0f + hysteresis);
+
+    // The first reading starts the average, and picks a side even inside the band
+    if (!hasTheme)
+    {
+        average = lux;
+        hasTheme = true;
+        theme = average < threshold ? ColorSetId_Dark : ColorSetId_Light;
+        interval = AMBIENT_LIGHT_MIN_INTERVAL;
+        return true;
+    }
+
+    // Readings far off the average mean the light is changing, so look again soon.
+    // Near the threshold, that's anything which could cross the band. Below 1 lux
+    // the sensor is mostly noise, so that's the least it compares against.
+    bool changing = std::fabs(lux - average) > std::max(std::max(average, threshold), 1.0f) * std::max(hysteresis, 0.1f);
+    average += (lux - average) * AMBIENT_LIGHT_SMOOTHING;
+
+    // Within twice the band, a few more readings may be enough to cross it
+    bool nearThreshold = average > threshold * (1.0f - 2.0f * hysteresis) && average < threshold * (1.0f + 2.0f * hysteresis);
+    u32 maxInterval = nearThreshold ? AMBIENT_LIGHT_MAX_INTERVAL_NEAR : AMBIENT_LIGHT_MAX_INTERVAL;
+    interval = changing ? AMBIENT_LIGHT_MIN_INTERVAL : std::min(interval * 2, maxInterval);
+
+    // Only leave the current theme once the average left the band on the other side
+    ColorSetId newTheme = theme;
+    if (average < lowerEdge)
+        newTheme = ColorSetId_Dark;
+    else if (average > upperEdge)
+        newTheme = ColorSetId_Light;
+
+    bool changed = newTheme != theme;
+    theme = newTheme;
+    return changed;
+}
@@ -0,0 +1,67 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <switch.h>
+
+// Default brightness (in lux) below which the dark theme is used
+#define AMBIENT_LIGHT_DEFAULT_THRESHOLD 20.0f
+
+// Default width of the band around the threshold, relative to it. Inside the band
+// the theme stays as it is.
+#define AMBIENT_LIGHT_DEFAULT_HYSTERESIS 0.25f
+
+// Weight of a new reading in the moving average
+#define AMBIENT_LIGHT_SMOOTHING 0.3f
+
+// Shortest and longest time between two readings (in seconds), and the longest
+// while the light is close to the threshold
+#define AMBIENT_LIGHT_MIN_INTERVAL 5
+#define AMBIENT_LIGHT_MAX_INTERVAL 160
+#define AMBIENT_LIGHT_MAX_INTERVAL_NEAR 20
+
+namespace nxlightswitch
+{
+    // Picks the theme from the ambient light sensor's readings. The readings are
+    // smoothed by an exponential moving average, and the theme only changes once
+    // the average leaves the band around the threshold, so a hand or a passing
+    // shadow doesn't flip it. It also tells when to read the sensor next: the
+    // interval doubles while the light is stable, up to AMBIENT_LIGHT_MAX_INTERVAL
+    // or only AMBIENT_LIGHT_MAX_INTERVAL_NEAR while the average is close to the
+    // threshold, and drops to AMBIENT_LIGHT_MIN_INTERVAL when the light changes.
+    class AmbientLightFilter
+    {
+    public:
+        AmbientLightFilter();
+
+        // Sets the threshold (in lux) and the band around it, and forgets the readings so far
+        void Configure(float threshold, float hysteresis);
+
+        // Takes in a reading (in lux). Returns true if the theme changed, which
+        // includes the first theme picked.
+        bool AddReading(float lux);
+
+        // Whether there was a reading to pick a theme from yet
+        bool HasTheme() const { return hasTheme; }
+
+        // The theme the readings ask for
+        ColorSetId GetTheme() const { return theme; }
+
+        // Seconds until the sensor should be read again
+        u32 GetInterval() const { return interval; }
+
+        // Moving average of the readings (in lux)
+        float GetAverage() const { return average; }
+
+    private:
+        float threshold;
+        float hysteresis;
+
+        bool hasTheme;
+        ColorSetId theme;
+        float average;
+        u32 interval;
+    };
+}
@@ -0,0 +1,162 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "clock.hpp"
+#include "logger.hpp"
+#include "tracer.hpp"
+using namespace nxlightswitch;
+
+// Needed for compiler
+Clock Clock::singleton;
+
+// The source the clock reads from unless it's given another one
+static SystemClockSource systemClockSource;
+
+u64 SystemClockSource::GetTick()
+{
+    return armGetSystemTick();
+}
+
+Result SystemClockSource::GetTime(u64* posixTime, s32* utcOffset)
+{
+    Result rc = timeGetCurrentTime(TimeType_UserSystemClock, posixTime);
+    if (R_FAILED(rc))
+        return rc;
+
+    // The offset changes with daylight saving time, which the next sync picks up
+    TimeCalendarTime calendarTime;
+    TimeCalendarAdditionalInfo calendarInfo;
+    rc = timeToCalendarTimeWithMyRule(*posixTime, &calendarTime, &calendarInfo);
+    if (R_FAILED(rc))
+        return rc;
+
+    *utcOffset = calendarInfo.offset;
+    return 0;
+}
+
+Clock::Clock()
+    : source(&systemClockSource), synced(false), syncTick(0), syncPosixTime(0), utcOffset(0), syncCount(0)
+{
+    resyncInterval = currentInterval = armNsToTicks(CLOCK_DEFAULT_RESYNC_INTERVAL * 1000000000ull);
+}
+
+Clock* Clock::get()
+{
+    return &singleton;
+}
+
+Result Clock::getCurrentTime(u64* posixTime, TimeCalendarTime* calendarTime)
+{
+    u64 nowTick = source->GetTick();
+    if (!synced || nowTick - syncTick >= currentInterval)
+    {
+        Result rc = sync(nowTick);
+        if (R_FAILED(rc))
+            return rc;
+    }
+
+    // Extrapolate from the last sync
+    *posixTime = syncPosixTime + armTicksToNs(nowTick - syncTick) / 1000000000ull;
+    toCalendarTime((s64)*posixTime + utcOffset, calendarTime);
+    return 0;
+}
+
+Result Clock::getCalendarTimeAtTick(u64 tick, TimeCalendarTime* calendarTime)
+{
+    // Makes sure the last sync is recent enough
+    u64 posixTime;
+    Result rc = getCurrentTime(&posixTime, calendarTime);
+    if (R_FAILED(rc))
+        return rc;
+
+    // Ticks before the sync round down to the second they happened in
+    if (tick >= syncTick)
+        posixTime = syncPosixTime + armTicksToNs(tick - syncTick) / 1000000000ull;
+    else
+        posixTime = syncPosixTime - (armTicksToNs(syncTick - tick) + 999999999ull) / 1000000000ull;
+
+    toCalendarTime((s64)posixTime + utcOffset, calendarTime);
+    return 0;
+}
+
+void Clock::setResyncInterval(u64 seconds)
+{
+    if (seconds < CLOCK_MIN_RESYNC_INTERVAL)
+        seconds = CLOCK_MIN_RESYNC_INTERVAL;
+
+    u64 interval = armNsToTicks(seconds * 1000000000ull);
+    if (interval != resyncInterval)
+    {
+        resyncInterval = currentInterval = interval;
+    }
+}
+
+void Clock::setSource(ClockSource* source)
+{
+    this->source = source;
+    synced = false;
+    currentInterval = resyncInterval;
+}
+
+Result Clock::sync(u64 nowTick)
+{
+    TRACE_SCOPE("Clock::sync");
+
+    u64 posixTime;
+    s32 newUtcOffset;
+    Result rc = source->GetTime(&posixTime, &newUtcOffset);
+    if (R_FAILED(rc))
+        return rc;
+
+    // Sync more often while the guesses are off, and less often again once they aren't
+    s64 drift = 0;
+    if (synced)
+    {
+        s64 expected = (s64)(syncPosixTime + armTicksToNs(nowTick - syncTick) / 1000000000ull);
+        u64 minInterval = armNsToTicks(CLOCK_MIN_RESYNC_INTERVAL * 1000000000ull);
+        drift = (s64)posixTime - expected;
+        if (drift > CLOCK_MAX_DRIFT || drift < -CLOCK_MAX_DRIFT)
+            currentInterval = currentInterval / 2 > minInterval ? currentInterval / 2 : minInterval;
+        else
+            currentInterval = currentInterval * 2 < resyncInterval ? currentInterval * 2 : resyncInterval;
+    }
+
+    synced = true;
+    syncTick = nowTick;
+    syncPosixTime = posixTime;
+    utcOffset = newUtcOffset;
+    syncCount++;
+
+    // Only log once synced, as logging reads the clock
+    if (drift > CLOCK_MAX_DRIFT || drift < -CLOCK_MAX_DRIFT)
+    {
+        LOG("Clock drifted by %d seconds", (int)drift);
+    }
+
+    return 0;
+}
+
+void Clock::toCalendarTime(s64 localTime, TimeCalendarTime* calendarTime)
+{
+    s64 days = localTime >= 0 ? localTime / 86400 : (localTime - 86399) / 86400;
+    s64 secondOfDay = localTime - days * 86400;
+
+    // Civil date of days since the epoch (Howard Hinnant's civil_from_days)
+    days += 719468;
+    s64 era = (days >= 0 ? days : days - 146096) / 146097;
+    s64 dayOfEra = days - era * 146097;
+    s64 yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    s64 dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    s64 monthIndex = (5 * dayOfYear + 2) / 153;
+    s64 month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+
+    *calendarTime = {};
+    calendarTime->year = (u16)(yearOfEra + era * 400 + (month <= 2));
+    calendarTime->month = (u8)month;
+    calendarTime->day = (u8)(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+    calendarTime->hour = (u8)(secondOfDay / 3600);
+    calendarTime->minute = (u8)(secondOfDay / 60 % 60);
+    calendarTime->second = (u8)(secondOfDay % 60);
+}
@@ -0,0 +1,101 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <switch.h>
+
+// Default time between two syncs with the time service (in seconds)
+#define CLOCK_DEFAULT_RESYNC_INTERVAL 300
+
+// Shortest time between two syncs, reached when the clock keeps drifting (in seconds)
+#define CLOCK_MIN_RESYNC_INTERVAL 30
+
+// Difference between the extrapolated and the real time which counts as drift (in seconds)
+#define CLOCK_MAX_DRIFT 2
+
+namespace nxlightswitch
+{
+    // Where the clock gets its ticks and the time from
+    class ClockSource
+    {
+    public:
+        virtual ~ClockSource() {}
+
+        // Gets the current system tick
+        virtual u64 GetTick() = 0;
+
+        // Asks for the console's time (user system clock) as POSIX time, and the
+        // time zone's offset from UTC at that time (in seconds)
+        virtual Result GetTime(u64* posixTime, s32* utcOffset) = 0;
+    };
+
+    // The CPU's system tick and the time service
+    class SystemClockSource : public ClockSource
+    {
+    public:
+        virtual u64 GetTick();
+        virtual Result GetTime(u64* posixTime, s32* utcOffset);
+    };
+
+    // Tells the console's time without asking the time service every time. The
+    // time and the time zone offset are synced from the time service once, then
+    // extrapolated using the CPU's system tick, which costs a register read.
+    // The clock syncs again after the resync interval, and more often (down to
+    // CLOCK_MIN_RESYNC_INTERVAL) while it finds the time drifted from its guess,
+    // e.g. because the user changed the clock. The ticks and the time come from a
+    // ClockSource, the system's unless a test gives it a virtual one. The clock
+    // isn't thread-safe, only the worker and the log writer use it, both on the
+    // main thread.
+    class Clock
+    {
+    public:
+        // Returns the singleton instance of the clock
+        static Clock* get();
+
+        // Gets the console's time (user system clock), as POSIX time and as local calendar time
+        Result getCurrentTime(u64* posixTime, TimeCalendarTime* calendarTime);
+
+        // Sets the time between two syncs (in seconds)
+        void setResyncInterval(u64 seconds);
+
+        // Gets the local calendar time at the given system tick, e.g. one an event was recorded at
+        Result getCalendarTimeAtTick(u64 tick, TimeCalendarTime* calendarTime);
+
+        // Makes the next reading sync with the time service
+        void invalidate() { synced = false; }
+
+        // Returns how often the time service was asked, for the logs
+        u32 getSyncCount() const { return syncCount; }
+
+        // Takes the ticks and the time from another source, and syncs with it on the next reading
+        void setSource(ClockSource* source);
+
+    private:
+        Clock();
+
+        ClockSource* source;
+
+        // Asks the source for the time and the time zone offset
+        Result sync(u64 nowTick);
+
+        // Converts local POSIX time to a calendar time
+        static void toCalendarTime(s64 localTime, TimeCalendarTime* calendarTime);
+
+        // Whether the values of the last sync can be extrapolated from
+        bool synced;
+        u64 syncTick;
+        u64 syncPosixTime;
+        s32 utcOffset;
+
+        // Configured and current time between two syncs, in system ticks
+        u64 resyncInterval;
+        u64 currentInterval;
+
+        u32 syncCount;
+
+        // Singleton instance
+        static Clock singleton;
+    };
+}
@@ -0,0 +1,397 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "exceptioncalendar.hpp"
+#include "logger.hpp"
+#include "scheduler.hpp"
+#include "ini/ini.h"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+using namespace nxlightswitch;
+
+// The theme of each day in the two years the rules are laid over, 0 for none or
+// 1 + the theme, and how many rules were laid over them
+struct ExceptionDays
+{
+    u8 themes[EXCEPTIONS_MAX_DAYS];
+    size_t dayCount;
+    u32 windowStart;
+    int year;
+    size_t ruleCount;
+};
+
+// Clears the days of the given year and the next one
+static void InitDays(ExceptionDays* days, int year)
+{
+    days->windowStart = (u32)Scheduler::MinuteFromCalendar(year, 1, 1, 0, 0);
+    days->dayCount = ((u32)Scheduler::MinuteFromCalendar(year + 2, 1, 1, 0, 0) - days->windowStart) / MINUTES_PER_DAY;
+    days->year = year;
+    days->ruleCount = 0;
+    memset(days->themes, 0, sizeof(days->themes));
+}
+
+// Lays a rule over the days, over the rules before it. Past the most rules
+// allowed they are only counted.
+static void AddRule(ExceptionDays* days, const ExceptionRule& rule)
+{
+    if (days->ruleCount++ >= EXCEPTIONS_MAX_RULES)
+        return;
+
+    // Repeating ranges are laid over every year overlapping the window,
+    // including last year's for ranges spanning New Year
+    u32 windowEnd = days->windowStart + days->dayCount * MINUTES_PER_DAY;
+    int firstYear = rule.year ? rule.year : days->year - 1;
+    int lastYear = rule.year ? rule.year : days->year + 1;
+    bool wraps = rule.toMonth * 32 + rule.toDay < rule.fromMonth * 32 + rule.fromDay;
+    for (int y = firstYear; y <= lastYear; y++)
+    {
+        u64 start = Scheduler::MinuteFromCalendar(y, rule.fromMonth, rule.fromDay, 0, 0);
+        u64 end = Scheduler::MinuteFromCalendar(wraps ? y + 1 : y, rule.toMonth, rule.toDay, 0, 0) + MINUTES_PER_DAY;
+        start = std::max(start, (u64)days->windowStart);
+        end = std::min(end, (u64)windowEnd);
+
+        for (u64 minute = start; minute < end; minute += MINUTES_PER_DAY)
+        {
+            if (!rule.weekdays || (rule.weekdays & (1 << (Scheduler::MinuteOfWeek(minute) / MINUTES_PER_DAY))))
+                days->themes[(minute - days->windowStart) / MINUTES_PER_DAY] = 1 + (u8)rule.theme;
+        }
+    }
+}
+
+// Parses a number of one or more digits, moving str past it
+static bool ParseNumber(const char** str, const char* end, int* number)
+{
+    const char* p = *str;
+    *number = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        *number = *number * 10 + (*p++ - '0');
+
+    if (p == *str)
+        return false;
+    *str = p;
+    return true;
+}
+
+// Parses a MM-DD or YYYY-MM-DD date, moving str past it. year is 0 for MM-DD.
+static bool ParseDate(const char** str, const char* end, int* year, int* month, int* day)
+{
+    int numbers[3];
+    int count = 0;
+    while (count < 3 && ParseNumber(str, end, &numbers[count]))
+    {
+        count++;
+        if (*str == end || **str != '-')
+            break;
+        (*str)++;
+    }
+
+    if (count == 2)
+    {
+        *year = 0;
+        *month = numbers[0];
+        *day = numbers[1];
+    }
+    else if (count == 3)
+    {
+        *year = numbers[0];
+        *month = numbers[1];
+        *day = numbers[2];
+    }
+    else
+    {
+        return false;
+    }
+
+    return *month >= 1 && *month <= 12 && *day >= 1 && *day <= 31 && (count == 2 || *year >= 1970);
+}
+
+// Skips spaces, moving str past them
+static void SkipSpaces(const char** str, const char* end)
+{
+    while (*str < end && (**str == ' ' || **str == '\t'))
+        (*str)++;
+}
+
+// Parses a comma separated list of day names into a weekday mask
+static bool ParseWeekdays(const char* str, const char* end, u8* weekdays)
+{
+    static const char* names[] = { "mon", "tue", "wed", "thu", "fri", "sat", "sun" };
+
+    *weekdays = 0;
+    while (str < end)
+    {
+        int day;
+        for (day = 0; day < 7; day++)
+        {
+            if (end - str >= 3 && strncasecmp(str, names[day], 3) == 0)
+                break;
+        }
+        if (day == 7)
+            return false;
+
+        *weekdays |= 1 << day;
+        str += 3;
+        SkipSpaces(&str, end);
+        if (str < end && *str++ != ',')
+            return false;
+        SkipSpaces(&str, end);
+    }
+
+    return *weekdays != 0;
+}
+
+// Called by ini_parse_stream for every name=value pair in the exceptions file
+static int ExceptionsHandler(void* user, const char* section, const char* name, const char* value)
+{
+    // Only look at the [Exceptions] section
+    if (strcasecmp(section, "Exceptions") != 0)
+        return 1;
+
+    // The name holds the dates
+    ExceptionRule rule;
+    const char* str = name;
+    const char* end = name + strlen(name);
+    if (!ParseDate(&str, end, &rule.year, &rule.fromMonth, &rule.fromDay))
+        return 0;
+
+    SkipSpaces(&str, end);
+    if (str == end)
+    {
+        rule.toMonth = rule.fromMonth;
+        rule.toDay = rule.fromDay;
+    }
+    else
+    {
+        int toYear;
+        if (end - str < 2 || strncasecmp(str, "to", 2) != 0)
+            return 0;
+        str += 2;
+        SkipSpaces(&str, end);
+        if (!ParseDate(&str, end, &toYear, &rule.toMonth, &rule.toDay) || str != end)
+            return 0;
+
+        // One-off ranges stay within their year, so they can't end before they start
+        if ((toYear == 0) != (rule.year == 0) || (rule.year && (toYear != rule.year
+            || rule.toMonth * 32 + rule.toDay < rule.fromMonth * 32 + rule.fromDay)))
+            return 0;
+    }
+
+    // The value holds the theme and the days
+    str = value;
+    end = value + strlen(value);
+    if (end - str >= 5 && strncasecmp(str, "light", 5) == 0)
+    {
+        rule.theme = ColorSetId_Light;
+        str += 5;
+    }
+    else if (end - str >= 4 && strncasecmp(str, "dark", 4) == 0)
+    {
+        rule.theme = ColorSetId_Dark;
+        str += 4;
+    }
+    else
+    {
+        return 0;
+    }
+
+    rule.weekdays = 0;
+    SkipSpaces(&str, end);
+    if (str < end && !ParseWeekdays(str, end, &rule.weekdays))
+        return 0;
+
+    AddRule(static_cast<ExceptionDays*>(user), rule);
+    return 1;
+}
+
+// Returns the theme an interval forces at the given minute, 0 for none or 1 + the theme
+static u8 GetIntervalTheme(u8 lightDays, u8 darkDays, u64 minute)
+{
+    u8 weekday = 1 << (Scheduler::MinuteOfWeek(minute) / MINUTES_PER_DAY);
+    return (lightDays & weekday) ? 1 + (u8)ColorSetId_Light : (darkDays & weekday) ? 1 + (u8)ColorSetId_Dark : 0;
+}
+
+bool ExceptionCalendar::Load(const char* path, int year)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return false;
+
+    // The rules are laid over the days as they are read, so only the days are kept
+    ExceptionDays days;
+    InitDays(&days, year);
+    int error = ini_parse_stream(ReadIniLine, file, ExceptionsHandler, &days);
+    fclose(file);
+    if (days.ruleCount > EXCEPTIONS_MAX_RULES)
+    {
+        LOG("Exceptions file lists %d rules, at most %d are supported", (int)days.ruleCount, EXCEPTIONS_MAX_RULES);
+        return false;
+    }
+    if (error)
+        LOG("Ignored invalid exception at line %d", error);
+
+    BuildIntervals(days.themes, days.dayCount, days.windowStart, year);
+    return true;
+}
+
+bool ExceptionCalendar::Build(const std::vector<ExceptionRule>& rules, int year)
+{
+    ExceptionDays days;
+    InitDays(&days, year);
+    for (size_t i = 0; i < rules.size(); i++)
+        AddRule(&days, rules[i]);
+    if (days.ruleCount > EXCEPTIONS_MAX_RULES)
+        return false;
+
+    BuildIntervals(days.themes, days.dayCount, days.windowStart, year);
+    return true;
+}
+
+void ExceptionCalendar::BuildIntervals(const u8* days, size_t dayCount, u32 windowStart, int year)
+{
+    count = 0;
+    this->year = year;
+
+    // Grow an interval day by day for as long as each day of the week keeps the
+    // theme it had the last time in the interval. The themes are 0xFF for the
+    // days of the week the interval didn't get to yet.
+    u8 weekThemes[7];
+    memset(weekThemes, 0xFF, sizeof(weekThemes));
+    size_t start = 0;
+    u32 firstWeekday = Scheduler::MinuteOfWeek(windowStart) / MINUTES_PER_DAY;
+    for (size_t day = 0; day <= dayCount; day++)
+    {
+        u32 weekday = (firstWeekday + day) % 7;
+        if (day < dayCount && (weekThemes[weekday] == 0xFF || weekThemes[weekday] == days[day]))
+        {
+            weekThemes[weekday] = days[day];
+            continue;
+        }
+
+        // This day doesn't fit, so close the interval and keep it if it forces anything
+        Interval interval = { windowStart + (u32)start * MINUTES_PER_DAY, windowStart + (u32)day * MINUTES_PER_DAY, 0, 0 };
+        for (u32 i = 0; i < 7; i++)
+        {
+            if (weekThemes[i] == 1 + (u8)ColorSetId_Light)
+                interval.lightDays |= 1 << i;
+            else if (weekThemes[i] == 1 + (u8)ColorSetId_Dark)
+                interval.darkDays |= 1 << i;
+        }
+        if (interval.lightDays || interval.darkDays)
+            intervals[count++] = interval;
+
+        memset(weekThemes, 0xFF, sizeof(weekThemes));
+        start = day;
+        if (day < dayCount)
+            weekThemes[weekday] = days[day];
+    }
+}
+
+size_t ExceptionCalendar::FindIndex(u64 minute) const
+{
+    // The intervals don't overlap, so their ends are sorted too
+    size_t low = 0, high = count;
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (intervals[middle].end <= minute)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+u8 ExceptionCalendar::GetDayTheme(u64 minute) const
+{
+    size_t index = FindIndex(minute);
+    if (index == count || intervals[index].start > minute)
+        return 0;
+    return GetIntervalTheme(intervals[index].lightDays, intervals[index].darkDays, minute);
+}
+
+bool ExceptionCalendar::Find(u64 minute, ColorSetId* theme) const
+{
+    u8 dayTheme = GetDayTheme(minute);
+    if (dayTheme == 0)
+        return false;
+
+    *theme = (ColorSetId)(dayTheme - 1);
+    return true;
+}
+
+bool ExceptionCalendar::GetNextBoundary(u64 minute, u64* boundary) const
+{
+    // The theme only changes at the start of a day. Within an interval the days
+    // of the week repeat, so if it doesn't change within a week it doesn't change
+    // until the interval ends.
+    u8 theme = GetDayTheme(minute);
+    u64 day = minute - minute % MINUTES_PER_DAY + MINUTES_PER_DAY;
+    while (true)
+    {
+        size_t index = FindIndex(day);
+        if (index == count || intervals[index].start > day)
+        {
+            // No exception on this day, and none until the next interval
+            if (theme != 0)
+                break;
+            if (index == count)
+                return false;
+            day = intervals[index].start;
+            continue;
+        }
+
+        const Interval& interval = intervals[index];
+        u64 weekEnd = std::min((u64)interval.end, day + MINUTES_PER_WEEK);
+        for (; day < weekEnd; day += MINUTES_PER_DAY)
+        {
+            if (GetIntervalTheme(interval.lightDays, interval.darkDays, day) != theme)
+                break;
+        }
+        if (day < weekEnd)
+            break;
+        day = interval.end;
+    }
+
+    *boundary = day;
+    return true;
+}
+
+bool ExceptionCalendar::GetLastBoundary(u64 minute, u64* boundary) const
+{
+    // Like GetNextBoundary, going back from the start of the day
+    u8 theme = GetDayTheme(minute);
+    u64 day = minute - minute % MINUTES_PER_DAY;
+    while (true)
+    {
+        size_t index = FindIndex(day - 1);
+        if (index == count || intervals[index].start >= day)
+        {
+            // No exception on the day before, and none back to the previous interval
+            if (theme != 0)
+                break;
+            if (index == 0)
+                return false;
+            day = intervals[index - 1].end;
+            continue;
+        }
+
+        const Interval& interval = intervals[index];
+        u64 weekStart = std::max((u64)interval.start, day - MINUTES_PER_WEEK);
+        for (; day > weekStart; day -= MINUTES_PER_DAY)
+        {
+            if (GetIntervalTheme(interval.lightDays, interval.darkDays, day - MINUTES_PER_DAY) != theme)
+                break;
+        }
+        if (day > weekStart)
+            break;
+        day = interval.start;
+    }
+
+    *boundary = day;
+    return true;
+}
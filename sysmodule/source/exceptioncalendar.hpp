@@ -0,0 +1,105 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <vector>
+#include <switch.h>
+
+// Path of the exceptions file
+#define EXCEPTIONS_PATH "sdmc:/config/NXLightSwitch/Exceptions.ini"
+
+// Most rules the exceptions file may list. A longer file isn't loaded and the
+// exceptions loaded before stay.
+#define EXCEPTIONS_MAX_RULES 4096
+
+// Days in the two years the rules are expanded for, and so the most intervals
+// they can turn into, as an interval starts on a different day than the last
+#define EXCEPTIONS_MAX_DAYS (2 * 366)
+
+namespace nxlightswitch
+{
+    // A range of days forcing a theme, possibly only on some days of the week
+    struct ExceptionRule
+    {
+        // Year of the range, or 0 if it repeats every year
+        int year;
+        int fromMonth, fromDay;
+        int toMonth, toDay;
+
+        // Bit 0 is Monday, bit 6 Sunday. 0 means every day.
+        u8 weekdays;
+
+        ColorSetId theme;
+    };
+
+    // Holds the date ranges which override the light/dark times, e.g. "dark from
+    // December 20 to January 5". When loaded, the rules are laid over the days of
+    // this year and the next one, with overlaps resolved in favor of the rule
+    // listed last, and the days are merged into a sorted array of disjoint
+    // intervals. Each interval has a theme per day of the week, so a rule for some
+    // days of the week stays one interval rather than one per day. Looking up the
+    // exception in effect, or the next minute that changes, is a binary search and
+    // doesn't allocate, and neither does loading. Minutes are counted like the
+    // Scheduler does (see Scheduler::MinuteFromCalendar).
+    class ExceptionCalendar
+    {
+    public:
+        ExceptionCalendar() : count(0), year(0) {}
+
+        // Loads the rules from an INI file with an [Exceptions] section holding
+        // "<from> to <to> = light|dark [days]" lines, where dates are MM-DD (every
+        // year) or YYYY-MM-DD and days is a list like "sat,sun". Single days can leave
+        // out "to <to>". The rules are expanded for the given year and the next one.
+        // Returns false if the file couldn't be read or lists more than
+        // EXCEPTIONS_MAX_RULES rules, which keeps the exceptions loaded before.
+        bool Load(const char* path, int year);
+
+        // Expands the given rules for the given year and the next one, replacing
+        // any loaded intervals. Returns false if there are more than EXCEPTIONS_MAX_RULES.
+        bool Build(const std::vector<ExceptionRule>& rules, int year);
+
+        // Gets the theme forced at the given minute. Returns false if no exception applies.
+        bool Find(u64 minute, ColorSetId* theme) const;
+
+        // Gets the first minute after the given one where the forced theme changes.
+        // Returns false if it doesn't change again within the loaded years.
+        bool GetNextBoundary(u64 minute, u64* boundary) const;
+
+        // Gets the last minute at or before the given one where the forced theme changed.
+        // Returns false if it didn't change within the loaded years.
+        bool GetLastBoundary(u64 minute, u64* boundary) const;
+
+        // Returns the year the intervals were expanded for, 0 if nothing was loaded
+        int GetYear() const { return year; }
+
+        // Returns how many intervals are loaded
+        size_t Count() const { return count; }
+
+    private:
+        // A range of whole days [start, end) in minutes, forcing light on the days
+        // of the week in lightDays and dark on those in darkDays (bit 0 is Monday)
+        struct Interval
+        {
+            u32 start;
+            u32 end;
+            u8 lightDays;
+            u8 darkDays;
+        };
+
+        // Merges the themes of the days starting at windowStart, 0 for none or
+        // 1 + the theme, into the intervals
+        void BuildIntervals(const u8* days, size_t dayCount, u32 windowStart, int year);
+
+        // Returns the index of the first interval ending after the given minute
+        size_t FindIndex(u64 minute) const;
+
+        // Returns the theme forced at the given minute, 0 for none or 1 + the theme
+        u8 GetDayTheme(u64 minute) const;
+
+        Interval intervals[EXCEPTIONS_MAX_DAYS];
+        size_t count;
+        int year;
+    };
+}
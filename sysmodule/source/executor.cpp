@@ -0,0 +1,120 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "executor.hpp"
+#include "tracer.hpp"
+using namespace nxlightswitch;
+
+Task::Task()
+    : timeout(0), deadline(0), hasWaiter(false), waiter()
+{
+}
+
+void Task::Sleep(u64 timeout)
+{
+    this->timeout = timeout;
+    hasWaiter = false;
+}
+
+void Task::WaitFor(Waiter waiter, u64 timeout)
+{
+    Sleep(timeout);
+    this->waiter = waiter;
+    hasWaiter = true;
+}
+
+Executor::Executor(Platform* platform)
+    : platform(platform), taskCount(0), stopped(false)
+{
+}
+
+bool Executor::Add(Task* task)
+{
+    if (taskCount == EXECUTOR_MAX_TASKS)
+        return false;
+
+    // Due right away
+    task->timeout = 0;
+    task->deadline = 0;
+    task->hasWaiter = false;
+    tasks[taskCount++] = task;
+    return true;
+}
+
+void Executor::Run()
+{
+    stopped = false;
+    Task* signalledTask = NULL;
+    bool timedOut = false;
+    u64 firstDeadline = 0;
+    while (taskCount > 0 && !stopped)
+    {
+        // Timing out means the first deadline passed, even if the tick is a bit behind
+        u64 now = platform->GetTick();
+        if (timedOut && firstDeadline > now)
+            now = firstDeadline;
+
+        // Step the tasks which are due. Going backwards, as finished tasks get
+        // replaced by the last one.
+        {
+            TRACE_SCOPE("Executor::Step");
+            for (s32 i = taskCount - 1; i >= 0; i--)
+            {
+                if (tasks[i] == signalledTask)
+                    Step(i, true, now);
+                else if (tasks[i]->deadline <= now)
+                    Step(i, false, now);
+            }
+        }
+
+        if (stopped || taskCount == 0)
+            break;
+
+        // Gather what every task waits for, and when the first one is due
+        Waiter waiters[EXECUTOR_MAX_TASKS];
+        Task* waiterTasks[EXECUTOR_MAX_TASKS];
+        s32 waiterCount = 0;
+        firstDeadline = UINT64_MAX;
+        for (s32 i = 0; i < taskCount; i++)
+        {
+            if (tasks[i]->hasWaiter)
+            {
+                waiters[waiterCount] = tasks[i]->waiter;
+                waiterTasks[waiterCount++] = tasks[i];
+            }
+            if (tasks[i]->deadline < firstDeadline)
+                firstDeadline = tasks[i]->deadline;
+        }
+
+        u64 timeout = firstDeadline == UINT64_MAX ? UINT64_MAX : firstDeadline > now ? armTicksToNs(firstDeadline - now) : 0;
+
+        s32 signalledIndex = -1;
+        Result waitResult = platform->Wait(waiters, waiterCount, timeout, &signalledIndex);
+        signalledTask = R_SUCCEEDED(waitResult) && signalledIndex >= 0 && signalledIndex < waiterCount
+            ? waiterTasks[signalledIndex] : NULL;
+        timedOut = R_VALUE(waitResult) == KERNELRESULT(TimedOut);
+    }
+}
+
+void Executor::Stop()
+{
+    stopped = true;
+}
+
+void Executor::Step(s32 taskIndex, bool signalled, u64 tick)
+{
+    // A step which doesn't say what to wait for runs again right away, without
+    // the waiter of an earlier step
+    Task* task = tasks[taskIndex];
+    task->timeout = 0;
+    task->hasWaiter = false;
+    if (!task->Step(signalled))
+    {
+        tasks[taskIndex] = tasks[--taskCount];
+        return;
+    }
+
+    task->deadline = task->timeout == UINT64_MAX ? UINT64_MAX : tick + armNsToTicks(task->timeout);
+}
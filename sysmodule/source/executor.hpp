@@ -0,0 +1,83 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <switch.h>
+#include "platform.hpp"
+
+// Most tasks the executor can run at once
+#ifndef EXECUTOR_MAX_TASKS
+#define EXECUTOR_MAX_TASKS 8
+#endif
+
+namespace nxlightswitch
+{
+    // A background activity run by the Executor. Tasks are stackless: every call
+    // to Step() runs the task until it has to wait, and before returning it says
+    // what it waits for next with Sleep() or WaitFor(), or it runs again right
+    // away. Anything that needs to survive a wait is kept in members.
+    class Task
+    {
+    public:
+        Task();
+        virtual ~Task() {}
+
+        // Runs the task's next step. signalled is true if the waiter the task waited
+        // for was signalled, false if the timeout passed. Returns false once the task
+        // is finished.
+        virtual bool Step(bool signalled) = 0;
+
+    protected:
+        // Runs the next step after the timeout (in nanoseconds), UINT64_MAX waits forever
+        void Sleep(u64 timeout);
+
+        // Runs the next step once the waiter was signalled or after the timeout
+        void WaitFor(Waiter waiter, u64 timeout);
+
+    private:
+        friend class Executor;
+
+        // Time to wait after this step (in nanoseconds), and the system tick the
+        // next step is due at, which the executor works out from it
+        u64 timeout;
+        u64 deadline;
+
+        bool hasWaiter;
+        Waiter waiter;
+    };
+
+    // Runs all of the module's tasks on the calling thread, so new activities don't
+    // need a thread and stack of their own. All the waiting happens in a single
+    // multi-wait on the waiters of every task. The deadlines come from the
+    // platform's tick, so a recorded run replays with the same timing.
+    class Executor
+    {
+    public:
+        Executor(Platform* platform);
+
+        // Adds a task, which takes its first step right away. Returns false if
+        // there's no room for it.
+        bool Add(Task* task);
+
+        // Runs the tasks until all of them finished or Stop() was called
+        void Run();
+
+        // Makes Run() return once the tasks which are due now took their step, or
+        // before the next round if none is taking its step
+        void Stop();
+
+    private:
+        // Runs a step of the task at the given index at the given tick, removing
+        // it once it finished
+        void Step(s32 taskIndex, bool signalled, u64 tick);
+
+        // The waiting goes through the platform, so it can be recorded
+        Platform* platform;
+
+        Task* tasks[EXECUTOR_MAX_TASKS];
+        s32 taskCount;
+        bool stopped;
+    };
+}
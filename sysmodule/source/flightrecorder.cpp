@@ -0,0 +1,73 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "flightrecorder.hpp"
+#include "clock.hpp"
+#include "logqueue.hpp"
+using namespace nxlightswitch;
+
+// Needed for compiler
+FlightRecorder FlightRecorder::singleton;
+
+// Buffer for the dump file, so opening it doesn't allocate one
+static char dumpFileBuffer[1024];
+
+FlightRecorder* FlightRecorder::get()
+{
+    return &singleton;
+}
+
+bool FlightRecorder::dump()
+{
+    // Keep the last few dumps, so the context of an earlier error survives a later one
+    char olderPath[64];
+    snprintf(olderPath, sizeof(olderPath), FLIGHT_RECORDER_OLD_FILE_PATH, FLIGHT_RECORDER_OLD_FILES);
+    remove(olderPath);
+    for (int i = FLIGHT_RECORDER_OLD_FILES - 1; i >= 0; i--)
+    {
+        char path[64];
+        if (i > 0)
+            snprintf(path, sizeof(path), FLIGHT_RECORDER_OLD_FILE_PATH, i);
+        else
+            snprintf(path, sizeof(path), "%s", FLIGHT_RECORDER_FILE_PATH);
+        rename(path, olderPath);
+        memcpy(olderPath, path, sizeof(path));
+    }
+
+    FILE* dumpFile = fopen(FLIGHT_RECORDER_FILE_PATH, "w");
+    if (!dumpFile)
+        return false;
+    setvbuf(dumpFile, dumpFileBuffer, _IOFBF, sizeof(dumpFileBuffer));
+
+    u32 endEvent = nextEvent.load(std::memory_order_acquire);
+    u32 count = endEvent < FLIGHT_RECORDER_EVENTS ? endEvent : FLIGHT_RECORDER_EVENTS;
+    for (u32 i = endEvent - count; i != endEvent; i++)
+    {
+        // Work on a copy, and skip events another thread overwrote or is still writing
+        const Slot& slot = slots[i % FLIGHT_RECORDER_EVENTS];
+        u32 sequence = slot.sequence.load(std::memory_order_acquire);
+        Event event;
+        memcpy(&event, &slot.event, sizeof(event));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence != i + 1 || slot.sequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+
+        char message[LOG_LINE_SIZE];
+        if (event.formatter(message, sizeof(message), event.format, event.args) < 0)
+            continue;
+
+        // Same line format as the log, so the log tools can read it too. Events only
+        // know their system tick, the clock works out the time from that.
+        TimeCalendarTime calendarTime = {};
+        Clock::get()->getCalendarTimeAtTick(event.tick, &calendarTime);
+
+        fprintf(dumpFile, "%02d-%02d-%04d %02d:%02d:%02d: %s\n", calendarTime.day, calendarTime.month, calendarTime.year,
+            calendarTime.hour, calendarTime.minute, calendarTime.second, message);
+    }
+
+    fflush(dumpFile);
+    fclose(dumpFile);
+    return true;
+}
@@ -0,0 +1,149 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <switch.h>
+#include "logformatcheck.hpp"
+
+// Path the recorded events get written to, in the same format as the log
+#define FLIGHT_RECORDER_FILE_PATH "sdmc:/NXLightSwitch.flight.txt"
+
+// Earlier dumps are kept as NXLightSwitch.flight.1.txt (the one before) and so on
+#define FLIGHT_RECORDER_OLD_FILE_PATH "sdmc:/NXLightSwitch.flight.%d.txt"
+#define FLIGHT_RECORDER_OLD_FILES 2
+
+// Number of events the recorder keeps, older ones get overwritten
+#define FLIGHT_RECORDER_EVENTS 128
+
+// Bytes an event has for its arguments
+#define FLIGHT_RECORDER_ARGS_SIZE 64
+
+// Records an event without logging it, printf style. The format has to be a string
+// literal, and string arguments have to stay valid (e.g. be literals too), as they
+// only get formatted when the events are dumped.
+#define RECORD(format, ...) \
+    do \
+    { \
+        static_assert(nxlightswitch::LogFormatCheck<decltype(nxlightswitch::LogArgTypes(__VA_ARGS__))>::Check(format), \
+            "Record arguments don't match the format: " format); \
+        nxlightswitch::FlightRecorder::get()->record(format, ##__VA_ARGS__); \
+    } while (0)
+
+namespace nxlightswitch
+{
+    // Keeps the last FLIGHT_RECORDER_EVENTS events in a ring in memory, for context
+    // around failures without writing routine events to the SD card. Recording an
+    // event stores the format, the system tick and the raw arguments, formatting
+    // only happens when the events get dumped, which happens on errors (see
+    // Logger::logError) or when requested.
+    class FlightRecorder
+    {
+    public:
+        // Returns the singleton instance of the recorder
+        static FlightRecorder* get();
+
+        // Records an event. Use RECORD or LOG instead, which check the format.
+        template <typename... Args>
+        void record(const char* format, const Args&... args)
+        {
+            static_assert(PackedSize<typename std::decay<const Args>::type...>::value <= FLIGHT_RECORDER_ARGS_SIZE,
+                "Too many arguments for the flight recorder");
+
+            // Mark the slot as being written while filling it in, see dump()
+            u32 index = nextEvent.fetch_add(1, std::memory_order_relaxed);
+            Slot& slot = slots[index % FLIGHT_RECORDER_EVENTS];
+            slot.sequence.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            slot.event.tick = armGetSystemTick();
+            slot.event.format = format;
+            slot.event.formatter = &Format<typename std::decay<const Args>::type...>;
+            Pack(slot.event.args, args...);
+            slot.sequence.store(index + 1, std::memory_order_release);
+        }
+
+        // Writes the recorded events to FLIGHT_RECORDER_FILE_PATH, oldest first, after
+        // moving the earlier dumps one back. Only the log writer's thread may call this.
+        bool dump();
+
+    private:
+        // Formats an event's arguments into a buffer, like snprintf
+        typedef int (*Formatter)(char* buffer, size_t size, const char* format, const u8* args);
+
+        struct Event
+        {
+            u64 tick;
+            const char* format;
+            Formatter formatter;
+            u8 args[FLIGHT_RECORDER_ARGS_SIZE];
+        };
+
+        // Any thread can record, so every slot holds the index of its event plus one
+        // once it's complete, and 0 while it's being written
+        struct Slot
+        {
+            std::atomic<u32> sequence;
+            Event event;
+        };
+
+        // Bytes the given arguments take up when packed
+        template <typename... Args>
+        struct PackedSize;
+
+        // Copies the arguments one after the other into the buffer
+        static void Pack(u8* buffer) {}
+
+        template <typename T, typename... Rest>
+        static void Pack(u8* buffer, const T& value, const Rest&... rest)
+        {
+            typename std::decay<const T>::type decayed = value;
+            memcpy(buffer, &decayed, sizeof(decayed));
+            Pack(buffer + sizeof(decayed), rest...);
+        }
+
+        // Unpacks the arguments one by one, then formats them all at once
+        template <typename... Unpacked>
+        static int FormatUnpacked(char* buffer, size_t size, const char* format, const u8* args, LogArgs<>, const Unpacked&... unpacked)
+        {
+            return snprintf(buffer, size, format, unpacked...);
+        }
+
+        template <typename T, typename... Rest, typename... Unpacked>
+        static int FormatUnpacked(char* buffer, size_t size, const char* format, const u8* args, LogArgs<T, Rest...>, const Unpacked&... unpacked)
+        {
+            T value;
+            memcpy(&value, args, sizeof(value));
+            return FormatUnpacked(buffer, size, format, args + sizeof(value), LogArgs<Rest...>(), unpacked..., value);
+        }
+
+        template <typename... Args>
+        static int Format(char* buffer, size_t size, const char* format, const u8* args)
+        {
+            return FormatUnpacked(buffer, size, format, args, LogArgs<Args...>());
+        }
+
+        Slot slots[FLIGHT_RECORDER_EVENTS];
+        std::atomic<u32> nextEvent;
+
+        // Singleton instance
+        static FlightRecorder singleton;
+    };
+
+    template <>
+    struct FlightRecorder::PackedSize<>
+    {
+        static constexpr size_t value = 0;
+    };
+
+    template <typename T, typename... Rest>
+    struct FlightRecorder::PackedSize<T, Rest...>
+    {
+        static constexpr size_t value = sizeof(T) + PackedSize<Rest...>::value;
+    };
+}
@@ -0,0 +1,38 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "foreground.hpp"
+using namespace nxlightswitch;
+
+PmForegroundTitleSource::PmForegroundTitleSource()
+    : processId(0), titleId(0)
+{
+}
+
+bool PmForegroundTitleSource::GetForegroundTitle(u64* outTitleId)
+{
+    *outTitleId = titleId;
+    return processId != 0;
+}
+
+bool PmForegroundTitleSource::Refresh()
+{
+    // Fails when no application is running
+    u64 currentProcessId = 0;
+    if (R_FAILED(pmdmntGetApplicationProcessId(&currentProcessId)))
+        currentProcessId = 0;
+
+    if (currentProcessId == processId)
+        return false;
+
+    // Only resolve the title ID when the process actually changed
+    u64 currentTitleId = 0;
+    if (currentProcessId != 0 && R_FAILED(pminfoGetProgramId(&currentTitleId, currentProcessId)))
+        currentProcessId = 0;
+
+    processId = currentProcessId;
+    titleId = currentTitleId;
+    return true;
+}
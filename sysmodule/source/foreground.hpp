@@ -0,0 +1,46 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <switch.h>
+
+namespace nxlightswitch
+{
+    // Tells which application is currently running in the foreground. The Worker
+    // only talks to this interface, so the title can be fed from somewhere else
+    // than the system services.
+    class ForegroundTitleSource
+    {
+    public:
+        virtual ~ForegroundTitleSource() {}
+
+        // Gets the title ID of the foreground application. Returns false if no
+        // application is running.
+        virtual bool GetForegroundTitle(u64* titleId) = 0;
+
+        // Looks for a new foreground application. There is nothing to wait on for
+        // that, so the Worker polls this once per tick and a change shows at the
+        // next tick. Returns true if the application changed since the last call.
+        virtual bool Refresh() { return false; }
+    };
+
+    // Reads the foreground application from the process manager (pm:dmnt and pm:info).
+    // pm:shell's process event is already consumed by ns, so this source can't
+    // subscribe to it without stealing events; Refresh() instead asks pm:dmnt for
+    // the application process and compares it with the last one.
+    class PmForegroundTitleSource : public ForegroundTitleSource
+    {
+    public:
+        PmForegroundTitleSource();
+
+        virtual bool GetForegroundTitle(u64* titleId);
+        virtual bool Refresh();
+
+    private:
+        // Process and title ID of the last seen application, 0 if none is running
+        u64 processId;
+        u64 titleId;
+    };
+}
@@ -0,0 +1,16 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+
+// Taken from libstratosphere for memory management
+#define MEMORY_PAGE_SIZE 0x1000
+
+// Size of the heap this sysmodule gets (see __libnx_initheap in main.cpp). The
+// Worker and the other long-lived objects are statics, so the heap holds the
+// title rules and the exception calendar, the config's values while they are
+// parsed, and open files. It has room for both tables at their caps while one
+// of them is rebuilt, which tests/heap_test.cpp checks.
+#define INNER_HEAP_SIZE (0x1e * MEMORY_PAGE_SIZE)
@@ -282,3 +282,172 @@ int ini_parse_string(const char* string, ini_handler handler, void* user) {
     return ini_parse_stream((ini_reader)ini_reader_string, &ctx, handler,
                             user);
 }
+
+/* Return pointer to first non-whitespace char in [s, end), or end. */
+static const char* span_lskip(const char* s, const char* end)
+{
+    while (s < end && isspace((unsigned char)(*s)))
+        s++;
+    return s;
+}
+
+/* Return new end of [s, end) with trailing whitespace chars stripped off. */
+static const char* span_rstrip(const char* s, const char* end)
+{
+    while (end > s && isspace((unsigned char)(end[-1])))
+        end--;
+    return end;
+}
+
+/* Bounded equivalent of find_chars_or_comment(): return pointer to first char
+   (of chars) or inline comment in [s, end), or end if neither found. Each
+   candidate char is located with memchr() rather than walking the line one
+   char at a time. */
+static const char* span_find_chars_or_comment(const char* s, const char* end,
+                                              const char* chars)
+{
+    const char* stop = end;
+    const char* p;
+
+    for (; chars && *chars; chars++) {
+        p = (const char*)memchr(s, *chars, (size_t)(stop - s));
+        if (p)
+            stop = p;
+    }
+#if INI_ALLOW_INLINE_COMMENTS
+    for (chars = INI_INLINE_COMMENT_PREFIXES; *chars; chars++) {
+        p = s;
+        while ((p = (const char*)memchr(p, *chars, (size_t)(stop - p)))) {
+            if (p > s && isspace((unsigned char)(p[-1]))) {
+                stop = p;
+                break;
+            }
+            p++;
+        }
+    }
+#endif
+    return stop;
+}
+
+/* Make an ini_span out of [begin, end). */
+static ini_span make_span(const char* begin, const char* end)
+{
+    ini_span span;
+    span.ptr = begin;
+    span.len = (size_t)(end - begin);
+    return span;
+}
+
+/* See documentation in header file. */
+int ini_parse_buffer(const char* buffer, size_t length,
+                     ini_span_handler handler, void* user)
+{
+    const ini_span none = { NULL, 0 };
+    ini_span section = { "", 0 };
+    ini_span prev_name = { NULL, 0 };
+
+    const char* buffer_end = buffer + length;
+    const char* line = buffer;
+    const char* line_end;
+    const char* next;
+    const char* start;
+    const char* end;
+    const char* value;
+    ini_span name;
+    int lineno = 0;
+    int error = 0;
+
+#undef HANDLER
+#if INI_HANDLER_LINENO
+#define HANDLER(u, s, n, v) handler(u, s, n, v, lineno)
+#else
+#define HANDLER(u, s, n, v) handler(u, s, n, v)
+#endif
+
+    /* Scan through buffer line by line */
+    for (; line < buffer_end; line = next) {
+        line_end = (const char*)memchr(line, '\n', (size_t)(buffer_end - line));
+        next = line_end ? line_end + 1 : buffer_end;
+        if (!line_end)
+            line_end = buffer_end;
+
+        lineno++;
+
+        start = line;
+#if INI_ALLOW_BOM
+        if (lineno == 1 && line_end - start >= 3 &&
+                           (unsigned char)start[0] == 0xEF &&
+                           (unsigned char)start[1] == 0xBB &&
+                           (unsigned char)start[2] == 0xBF) {
+            start += 3;
+        }
+#endif
+        end = span_rstrip(start, line_end);
+        start = span_lskip(start, end);
+
+        if (start == end || strchr(INI_START_COMMENT_PREFIXES, *start)) {
+            /* Blank line or start-of-line comment */
+        }
+#if INI_ALLOW_MULTILINE
+        else if (prev_name.len && start > line) {
+            /* Non-blank line with leading whitespace, treat as continuation
+               of previous name's value (as per Python configparser). */
+            if (!HANDLER(user, section, prev_name, make_span(start, end)) &&
+                !error)
+                error = lineno;
+        }
+#endif
+        else if (*start == '[') {
+            /* A "[section]" line */
+            value = span_find_chars_or_comment(start + 1, end, "]");
+            if (value < end && *value == ']') {
+                section = make_span(start + 1, value);
+                prev_name = none;
+#if INI_CALL_HANDLER_ON_NEW_SECTION
+                if (!HANDLER(user, section, none, none) && !error)
+                    error = lineno;
+#endif
+            }
+            else if (!error) {
+                /* No ']' found on section line */
+                error = lineno;
+            }
+        }
+        else {
+            /* Not a comment, must be a name[=:]value pair */
+            value = span_find_chars_or_comment(start, end, "=:");
+            if (value < end && (*value == '=' || *value == ':')) {
+                name = make_span(start, span_rstrip(start, value));
+                value++;
+#if INI_ALLOW_INLINE_COMMENTS
+                end = span_find_chars_or_comment(value, end, NULL);
+#endif
+                value = span_lskip(value, end);
+                end = span_rstrip(value, end);
+
+                /* Valid name[=:]value pair found, call handler */
+                prev_name = name;
+                if (!HANDLER(user, section, name, make_span(value, end)) &&
+                    !error)
+                    error = lineno;
+            }
+            else if (!error) {
+                /* No '=' or ':' found on name[=:]value line */
+#if INI_ALLOW_NO_VALUE
+                name = make_span(start, span_rstrip(start, value));
+                if (!HANDLER(user, section, name, none) && !error)
+                    error = lineno;
+#else
+                error = lineno;
+#endif
+            }
+        }
+
+#if INI_STOP_ON_FIRST_ERROR
+        if (error)
+            break;
+#endif
+    }
+
+    return error;
+}
@@ -69,6 +69,32 @@ instead of a file. Useful for parsing INI data from a network socket or
 already in memory. */
 int ini_parse_string(const char* string, ini_handler handler, void* user);
 
+/* A pointer/length pair pointing into the buffer given to ini_parse_buffer().
+   Not zero-terminated. ptr is NULL (and len 0) for absent names or values. */
+typedef struct {
+    const char* ptr;
+    size_t len;
+} ini_span;
+
+/* Typedef for prototype of span handler function used by ini_parse_buffer(). */
+#if INI_HANDLER_LINENO
+typedef int (*ini_span_handler)(void* user, ini_span section, ini_span name,
+                                ini_span value, int lineno);
+#else
+typedef int (*ini_span_handler)(void* user, ini_span section, ini_span name,
+                                ini_span value);
+#endif
+
+/* Same as ini_parse_string(), but takes a buffer and its length instead of a
+   zero-terminated string, and never copies: section, name and value are
+   handed to the handler as spans into the given buffer, which must outlive
+   the handler calls. Line and delimiter boundaries are found with memchr(),
+   so there is no INI_MAX_LINE limit and names or sections are not truncated
+   to MAX_NAME/MAX_SECTION. Return values are the same as ini_parse(), apart
+   from -1 and -2 which can't happen. */
+int ini_parse_buffer(const char* buffer, size_t length,
+                     ini_span_handler handler, void* user);
+
 /* Nonzero to allow multi-line value parsing, in the style of Python's
    configparser. If allowed, ini_parse() will call the handler with the same
    name for each subsequent line parsed. */
@@ -12,6 +12,8 @@
 #include <algorithm>
 #include <cctype>
 #include <cstdlib>
+#include <cstring>
+#include <strings.h>
 #include "ini.h"
 #include "inireader.hpp"
 
@@ -20,12 +22,13 @@ using std::string;
 INIReader::INIReader(const string& filename)
 {
     _error = ini_parse(filename.c_str(), ValueHandler, this);
+    BuildIndex();
 }
 
 INIReader::INIReader(const char *buffer, size_t buffer_size)
 {
-  string content(buffer, buffer_size);
-  _error = ini_parse_string(content.c_str(), ValueHandler, this);
+    _error = ini_parse_buffer(buffer, buffer_size, SpanHandler, this);
+    BuildIndex();
 }
 
 int INIReader::ParseError() const
@@ -94,6 +97,96 @@ bool INIReader::HasValue(const string& section, const string& name) const
     return _values.count(key);
 }
 
+const char* INIReader::Get(const INIKey& key, const char* default_value) const
+{
+    const string* value = Find(key);
+    return value ? value->c_str() : default_value;
+}
+
+const char* INIReader::GetString(const INIKey& key, const char* default_value) const
+{
+    const string* value = Find(key);
+    return value && !value->empty() ? value->c_str() : default_value;
+}
+
+long INIReader::GetInteger(const INIKey& key, long default_value) const
+{
+    const char* value = Get(key, "");
+    char* end;
+    // This parses "1234" (decimal) and also "0x4D2" (hex)
+    long n = strtol(value, &end, 0);
+    return end > value ? n : default_value;
+}
+
+double INIReader::GetReal(const INIKey& key, double default_value) const
+{
+    const char* value = Get(key, "");
+    char* end;
+    double n = strtod(value, &end);
+    return end > value ? n : default_value;
+}
+
+bool INIReader::GetBoolean(const INIKey& key, bool default_value) const
+{
+    const char* value = Get(key, "");
+    if (!strcasecmp(value, "true") || !strcasecmp(value, "yes") ||
+        !strcasecmp(value, "on") || !strcasecmp(value, "1"))
+        return true;
+    else if (!strcasecmp(value, "false") || !strcasecmp(value, "no") ||
+             !strcasecmp(value, "off") || !strcasecmp(value, "0"))
+        return false;
+    else
+        return default_value;
+}
+
+bool INIReader::HasValue(const INIKey& key) const
+{
+    return Find(key) != NULL;
+}
+
+void INIReader::BuildIndex()
+{
+    // Keep the table at most half full so probe sequences stay short
+    size_t size = 8;
+    while (size < _values.size() * 2)
+        size *= 2;
+
+    IndexSlot empty = { 0, NULL, NULL };
+    _index.assign(size, empty);
+    for (std::map<string, string>::const_iterator it = _values.begin(); it != _values.end(); ++it)
+    {
+        uint32_t hash = INIKey::HashString(it->first.c_str(), 2166136261u);
+        size_t i = hash & (size - 1);
+        while (_index[i].key)
+            i = (i + 1) & (size - 1);
+        _index[i].hash = hash;
+        _index[i].key = &it->first;
+        _index[i].value = &it->second;
+    }
+}
+
+const string* INIReader::Find(const INIKey& key) const
+{
+    if (_index.empty())
+        return NULL;
+
+    size_t mask = _index.size() - 1;
+    for (size_t i = key.hash & mask; _index[i].key; i = (i + 1) & mask)
+    {
+        if (_index[i].hash != key.hash)
+            continue;
+
+        // Verify the stored "section=name" key against the requested one
+        const char* stored = _index[i].key->c_str();
+        size_t sectionLength = strlen(key.section);
+        if (strncasecmp(stored, key.section, sectionLength) == 0 &&
+            stored[sectionLength] == '=' &&
+            strcasecmp(stored + sectionLength + 1, key.name) == 0)
+            return _index[i].value;
+    }
+    return NULL;
+}
+
 string INIReader::MakeKey(const string& section, const string& name)
 {
     string key = section + "=" + name;
@@ -114,3 +207,17 @@ int INIReader::ValueHandler(void* user, const char* section, const char* name,
     reader->_values[key] += value ? value : "";
     return 1;
 }
+
+int INIReader::SpanHandler(void* user, ini_span section, ini_span name,
+                           ini_span value)
+{
+    if (!name.ptr)  // Happens when INI_CALL_HANDLER_ON_NEW_SECTION enabled
+        return 1;
+    INIReader* reader = static_cast<INIReader*>(user);
+    string key = MakeKey(string(section.ptr, section.len), string(name.ptr, name.len));
+    if (reader->_values[key].size() > 0)
+        reader->_values[key] += "\n";
+    if (value.ptr)
+        reader->_values[key].append(value.ptr, value.len);
+    return 1;
+}
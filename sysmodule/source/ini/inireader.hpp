@@ -14,6 +14,39 @@
 
 #include <map>
 #include <string>
+#include <vector>
+#include <stdint.h>
+#include "ini.h"
+
+// A section/name pair identifying an INI value. Constructing it from string
+// literals in a constexpr context computes the key's case-insensitive FNV-1a
+// hash at compile time, so a lookup through INIReader is a single hash probe
+// plus one verifying compare, with no std::string built on the way.
+class INIKey
+{
+public:
+    constexpr INIKey(const char* section, const char* name)
+        : section(section), name(name),
+          hash(HashString(name, HashChar('=', HashString(section, 2166136261u))))
+    {
+    }
+
+    // Hash of a (lower case) "section=name" string, as stored by INIReader.
+    static constexpr uint32_t HashString(const char* s, uint32_t h)
+    {
+        return *s ? HashString(s + 1, HashChar(*s, h)) : h;
+    }
+
+    const char* section;
+    const char* name;
+    uint32_t hash;
+
+private:
+    static constexpr uint32_t HashChar(char c, uint32_t h)
+    {
+        return (h ^ (uint8_t)(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c)) * 16777619u;
+    }
+};
 
 // Read an INI file into easy-to-access name/value pairs. (Note that I've gone
 // for simplicity here rather than speed, but it should be pretty decent.)
@@ -28,6 +61,10 @@ public:
     // about the parsing.
     explicit INIReader(const char *buffer, size_t buffer_size);
 
+    // The lookup index points into _values, so INIReader can't be copied.
+    INIReader(const INIReader&) = delete;
+    INIReader& operator=(const INIReader&) = delete;
+
     // Return the result of ini_parse(), i.e., 0 on success, line number of
     // first error on parse error, or -1 on file open error.
     int ParseError() const;
@@ -62,12 +99,35 @@ public:
     // Return true if a value exists with the given section and field names.
     bool HasValue(const std::string& section, const std::string& name) const;
 
+    // Non-allocating versions of the getters above, looking the value up by a
+    // precomputed INIKey. Strings returned are owned by the INIReader, and
+    // typed getters parse straight from the stored value.
+    const char* Get(const INIKey& key, const char* default_value) const;
+    const char* GetString(const INIKey& key, const char* default_value) const;
+    long GetInteger(const INIKey& key, long default_value) const;
+    double GetReal(const INIKey& key, double default_value) const;
+    bool GetBoolean(const INIKey& key, bool default_value) const;
+    bool HasValue(const INIKey& key) const;
+
 private:
+    // Open addressing hash table over _values, built once parsing is done
+    struct IndexSlot
+    {
+        uint32_t hash;
+        const std::string* key;
+        const std::string* value;
+    };
+
     int _error;
     std::map<std::string, std::string> _values;
+    std::vector<IndexSlot> _index;
+    void BuildIndex();
+    const std::string* Find(const INIKey& key) const;
     static std::string MakeKey(const std::string& section, const std::string& name);
     static int ValueHandler(void* user, const char* section, const char* name,
                             const char* value);
+    static int SpanHandler(void* user, ini_span section, ini_span name,
+                           ini_span value);
 };
 
 #endif  // __INIREADER_H__
@@ -0,0 +1,446 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "inputtrace.hpp"
+#include "executor.hpp"
+#include "logger.hpp"
+#include "utils.hpp"
+#include "worker.hpp"
+#include <cstring>
+using namespace nxlightswitch;
+
+// Identifies input traces ("NXLI"), bump the version whenever the format changes
+#define INPUT_TRACE_MAGIC 0x494C584E
+#define INPUT_TRACE_VERSION 6
+
+// A config record has to fit a record's u16 size next to the read flag
+static_assert(CONFIG_MAX_SIZE + sizeof(u32) <= 0xFFFF, "The config doesn't fit a trace record");
+
+// Returned by the replay when the Worker asks for something else than was recorded
+#define REPLAY_MISMATCH_RESULT MAKERESULT(Module_Libnx, LibnxError_BadInput)
+
+// Payloads of the fixed-size records
+struct TimeInput
+{
+    Result result;
+    u32 padding;
+    u64 posixTime;
+    TimeCalendarTime calendarTime;
+};
+
+struct ColorSetInput
+{
+    Result result;
+    u32 theme;
+};
+
+struct BrightnessInput
+{
+    Result result;
+    float brightness;
+};
+
+struct AmbientLightInput
+{
+    Result result;
+    float lux;
+};
+
+struct ForegroundTitleInput
+{
+    u32 running;
+    u32 padding;
+    u64 titleId;
+};
+
+struct WaitInput
+{
+    Result result;
+    s32 index;
+    u64 timeout;
+    u64 waited;
+};
+
+RecordingPlatform::RecordingPlatform(Platform* inner, ForegroundTitleSource* innerTitleSource)
+    : inner(inner), innerTitleSource(innerTitleSource), traceFile(NULL), started(false), lateRequestLogged(false), configRead(false), configSize(0), configHash(0), configBuffer(NULL)
+{
+}
+
+RecordingPlatform::~RecordingPlatform()
+{
+    SetRecording(false);
+}
+
+u64 RecordingPlatform::GetTick()
+{
+    started = true;
+    u64 tick = inner->GetTick();
+    Write(InputType_Tick, &tick, sizeof(tick));
+    return tick;
+}
+
+Result RecordingPlatform::GetCurrentTime(u64* posixTime, TimeCalendarTime* calendarTime)
+{
+    TimeInput input = {};
+    input.result = inner->GetCurrentTime(&input.posixTime, &input.calendarTime);
+    if (R_SUCCEEDED(input.result))
+    {
+        *posixTime = input.posixTime;
+        *calendarTime = input.calendarTime;
+    }
+
+    Write(InputType_Time, &input, sizeof(input));
+    return input.result;
+}
+
+Result RecordingPlatform::GetColorSetId(ColorSetId* theme)
+{
+    ColorSetInput input = {};
+    input.result = inner->GetColorSetId(theme);
+    if (R_SUCCEEDED(input.result))
+        input.theme = *theme;
+
+    Write(InputType_GetColorSet, &input, sizeof(input));
+    return input.result;
+}
+
+Result RecordingPlatform::SetColorSetId(ColorSetId theme)
+{
+    ColorSetInput input = {};
+    input.result = inner->SetColorSetId(theme);
+    input.theme = theme;
+
+    Write(InputType_SetColorSet, &input, sizeof(input));
+    return input.result;
+}
+
+Result RecordingPlatform::SetBrightness(float brightness)
+{
+    BrightnessInput input = {};
+    input.result = inner->SetBrightness(brightness);
+    input.brightness = brightness;
+
+    Write(InputType_SetBrightness, &input, sizeof(input));
+    return input.result;
+}
+
+Result RecordingPlatform::GetAmbientLight(float* lux)
+{
+    AmbientLightInput input = {};
+    input.result = inner->GetAmbientLight(&input.lux);
+    if (R_SUCCEEDED(input.result))
+        *lux = input.lux;
+
+    Write(InputType_AmbientLight, &input, sizeof(input));
+    return input.result;
+}
+
+bool RecordingPlatform::ReadFile(const char* path, char* buffer, size_t capacity, size_t* size)
+{
+    bool read = inner->ReadFile(path, buffer, capacity, size);
+
+    // Only the config gets read on every tick, so only record it when it changed
+    u32 hash = read ? HashBytes(buffer, *size) : 0;
+    bool changed = read != configRead || (read && (*size != configSize || hash != configHash));
+    if (changed && (!read || *size <= CONFIG_MAX_SIZE))
+    {
+        configRead = read;
+        configSize = read ? *size : 0;
+        configHash = hash;
+        WriteConfig();
+    }
+    configBuffer = buffer;
+
+    return read;
+}
+
+Result RecordingPlatform::Wait(const Waiter* waiters, s32 count, u64 timeout, s32* index)
+{
+    started = true;
+    WaitInput input = {};
+    u64 startTick = armGetSystemTick();
+    input.result = inner->Wait(waiters, count, timeout, index);
+    input.index = *index;
+    input.timeout = timeout;
+    input.waited = armTicksToNs(armGetSystemTick() - startTick);
+
+    Write(InputType_Wait, &input, sizeof(input));
+
+    // Once per tick is plenty to get the records onto the SD card
+    if (traceFile && timeout > 0)
+        fflush(traceFile);
+
+    return input.result;
+}
+
+void RecordingPlatform::SetRecording(bool enable)
+{
+    if (!enable && traceFile)
+    {
+        fclose(traceFile);
+        traceFile = NULL;
+    }
+
+    if (!enable || traceFile)
+        return;
+
+    if (!started)
+    {
+        Open();
+    }
+    else if (!lateRequestLogged)
+    {
+        LOG("Recording inputs starts with the module, restart it to record");
+        lateRequestLogged = true;
+    }
+}
+
+bool RecordingPlatform::GetForegroundTitle(u64* titleId)
+{
+    ForegroundTitleInput input = {};
+    input.running = innerTitleSource->GetForegroundTitle(&input.titleId) ? 1 : 0;
+    *titleId = input.titleId;
+
+    Write(InputType_ForegroundTitle, &input, sizeof(input));
+    return input.running != 0;
+}
+
+bool RecordingPlatform::Refresh()
+{
+    u32 changed = innerTitleSource->Refresh() ? 1 : 0;
+    Write(InputType_ForegroundChange, &changed, sizeof(changed));
+    return changed != 0;
+}
+
+void RecordingPlatform::Open()
+{
+    traceFile = fopen(INPUT_TRACE_PATH, "wb");
+    if (!traceFile)
+        return;
+
+    InputTraceHeader header = { INPUT_TRACE_MAGIC, INPUT_TRACE_VERSION };
+    fwrite(&header, sizeof(header), 1, traceFile);
+    WriteConfig();
+    LOG("Recording inputs to %s", INPUT_TRACE_PATH);
+}
+
+void RecordingPlatform::Write(u8 type, const void* payload, size_t size, const void* extra, size_t extraSize)
+{
+    if (!traceFile)
+        return;
+
+    InputRecordHeader header = { type, 0, (u16)(size + extraSize) };
+    fwrite(&header, sizeof(header), 1, traceFile);
+    fwrite(payload, 1, size, traceFile);
+    if (extraSize)
+        fwrite(extra, 1, extraSize, traceFile);
+}
+
+void RecordingPlatform::WriteConfig()
+{
+    u32 read = configRead ? 1 : 0;
+    Write(InputType_Config, &read, sizeof(read), configBuffer, configSize);
+}
+
+ReplayPlatform::ReplayPlatform()
+    : position(0), tick(0), executor(NULL), configRead(false), decisionCount(0), mismatchCount(0)
+{
+}
+
+bool ReplayPlatform::Load(const char* path)
+{
+    FILE* traceFile = fopen(path, "rb");
+    if (!traceFile)
+        return false;
+
+    InputTraceHeader header;
+    if (fread(&header, sizeof(header), 1, traceFile) != 1 || header.magic != INPUT_TRACE_MAGIC || header.version != INPUT_TRACE_VERSION)
+    {
+        fclose(traceFile);
+        return false;
+    }
+
+    u8 chunk[512];
+    size_t read;
+    trace.clear();
+    while ((read = fread(chunk, 1, sizeof(chunk), traceFile)) > 0)
+        trace.insert(trace.end(), chunk, chunk + read);
+    fclose(traceFile);
+
+    position = 0;
+    return true;
+}
+
+u64 ReplayPlatform::GetTick()
+{
+    u64 recordedTick;
+    if (Next(InputType_Tick, &recordedTick, sizeof(recordedTick)))
+        tick = recordedTick;
+    return tick;
+}
+
+Result ReplayPlatform::GetCurrentTime(u64* posixTime, TimeCalendarTime* calendarTime)
+{
+    TimeInput input;
+    if (!Next(InputType_Time, &input, sizeof(input)))
+        return REPLAY_MISMATCH_RESULT;
+
+    if (R_SUCCEEDED(input.result))
+    {
+        *posixTime = input.posixTime;
+        *calendarTime = input.calendarTime;
+    }
+    return input.result;
+}
+
+Result ReplayPlatform::GetColorSetId(ColorSetId* theme)
+{
+    ColorSetInput input;
+    if (!Next(InputType_GetColorSet, &input, sizeof(input)))
+        return REPLAY_MISMATCH_RESULT;
+
+    if (R_SUCCEEDED(input.result))
+        *theme = (ColorSetId)input.theme;
+    return input.result;
+}
+
+Result ReplayPlatform::SetColorSetId(ColorSetId theme)
+{
+    decisionCount++;
+    ColorSetInput input;
+    if (!Next(InputType_SetColorSet, &input, sizeof(input)))
+        return REPLAY_MISMATCH_RESULT;
+
+    // Same call, but a different decision
+    if (input.theme != (u32)theme)
+        mismatchCount++;
+    return input.result;
+}
+
+Result ReplayPlatform::SetBrightness(float brightness)
+{
+    decisionCount++;
+    BrightnessInput input;
+    if (!Next(InputType_SetBrightness, &input, sizeof(input)))
+        return REPLAY_MISMATCH_RESULT;
+
+    if (input.brightness != brightness)
+        mismatchCount++;
+    return input.result;
+}
+
+Result ReplayPlatform::GetAmbientLight(float* lux)
+{
+    AmbientLightInput input;
+    if (!Next(InputType_AmbientLight, &input, sizeof(input)))
+        return REPLAY_MISMATCH_RESULT;
+
+    if (R_SUCCEEDED(input.result))
+        *lux = input.lux;
+    return input.result;
+}
+
+bool ReplayPlatform::ReadFile(const char* path, char* buffer, size_t capacity, size_t* size)
+{
+    SkipConfig();
+    if (!configRead)
+        return false;
+
+    // Like the file system, report a config which doesn't fit as filling the buffer
+    if (config.size() > capacity)
+    {
+        *size = capacity;
+        return false;
+    }
+
+    memcpy(buffer, config.data(), config.size());
+    *size = config.size();
+    return true;
+}
+
+Result ReplayPlatform::Wait(const Waiter* waiters, s32 count, u64 timeout, s32* index)
+{
+    // Don't actually wait, that's the point of the replay
+    *index = -1;
+    if (executor && IsFinished())
+    {
+        executor->Stop();
+        return KERNELRESULT(TimedOut);
+    }
+
+    WaitInput input;
+    if (!Next(InputType_Wait, &input, sizeof(input)))
+        return KERNELRESULT(TimedOut);
+
+    // Same wait, but planned for another time
+    if (input.timeout != timeout)
+        mismatchCount++;
+
+    *index = input.index < count ? input.index : -1;
+    return input.result;
+}
+
+bool ReplayPlatform::GetForegroundTitle(u64* titleId)
+{
+    ForegroundTitleInput input;
+    if (!Next(InputType_ForegroundTitle, &input, sizeof(input)))
+        return false;
+
+    *titleId = input.titleId;
+    return input.running != 0;
+}
+
+bool ReplayPlatform::Refresh()
+{
+    u32 changed;
+    return Next(InputType_ForegroundChange, &changed, sizeof(changed)) && changed != 0;
+}
+
+bool ReplayPlatform::IsFinished()
+{
+    SkipConfig();
+    return position >= trace.size();
+}
+
+bool ReplayPlatform::Next(u8 type, void* payload, size_t size)
+{
+    SkipConfig();
+    if (position + sizeof(InputRecordHeader) > trace.size())
+    {
+        mismatchCount++;
+        return false;
+    }
+
+    InputRecordHeader header;
+    memcpy(&header, &trace[position], sizeof(header));
+    if (header.type != type || header.size != size || position + sizeof(header) + header.size > trace.size())
+    {
+        mismatchCount++;
+        return false;
+    }
+
+    // Records are packed, so copy the payload out rather than pointing into the trace
+    memcpy(payload, &trace[position + sizeof(header)], size);
+    position += sizeof(header) + header.size;
+    return true;
+}
+
+void ReplayPlatform::SkipConfig()
+{
+    while (position + sizeof(InputRecordHeader) <= trace.size())
+    {
+        InputRecordHeader header;
+        memcpy(&header, &trace[position], sizeof(header));
+        if (header.type != InputType_Config || position + sizeof(header) + header.size > trace.size() || header.size < sizeof(u32))
+            return;
+
+        const u8* payload = &trace[position + sizeof(header)];
+        u32 read;
+        memcpy(&read, payload, sizeof(read));
+        configRead = read != 0;
+        config.assign(payload + sizeof(read), payload + header.size);
+        position += sizeof(header) + header.size;
+    }
+}
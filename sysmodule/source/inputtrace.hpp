@@ -0,0 +1,160 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <cstdio>
+#include <vector>
+#include "foreground.hpp"
+#include "platform.hpp"
+
+// Path the recorded inputs get written to
+#define INPUT_TRACE_PATH "sdmc:/NXLightSwitch.inputs.bin"
+
+namespace nxlightswitch
+{
+    class Executor;
+
+    // The input trace is a small header followed by records, each one an
+    // InputRecordHeader and `size` bytes of payload, in the order the Worker
+    // asked for the inputs. The config is only recorded when its contents change.
+    enum InputType
+    {
+        InputType_Time = 1,         // Result, u32 padding, u64 POSIX time, TimeCalendarTime
+        InputType_GetColorSet = 2,  // Result, u32 theme
+        InputType_SetColorSet = 3,  // Result, u32 theme
+        InputType_SetBrightness = 4, // Result, float brightness
+        InputType_Config = 5,       // u32 1 if the file could be read, then its contents
+        InputType_Wait = 6,         // Result, s32 signalled waiter, u64 timeout, u64 nanoseconds waited
+        InputType_AmbientLight = 7, // Result, float lux
+        InputType_Tick = 8,         // u64 system tick
+        InputType_ForegroundTitle = 9, // u32 1 if an application is running, u32 padding, u64 title ID
+        InputType_ForegroundChange = 10 // u32 1 if the foreground application changed
+    };
+
+    struct InputTraceHeader
+    {
+        u32 magic;
+        u32 version;
+    };
+
+    struct InputRecordHeader
+    {
+        u8 type;
+        u8 reserved;
+        u16 size;
+    };
+
+    // Passes every call on to another platform and title source, and records what
+    // came back. A trace has to start with the module for the replay to end up in
+    // the same state, so recording can only be turned on before the executor's
+    // first tick. The config read before that goes into the trace first.
+    class RecordingPlatform : public Platform, public ForegroundTitleSource
+    {
+    public:
+        RecordingPlatform(Platform* inner, ForegroundTitleSource* innerTitleSource);
+        virtual ~RecordingPlatform();
+
+        virtual u64 GetTick();
+        virtual Result GetCurrentTime(u64* posixTime, TimeCalendarTime* calendarTime);
+        virtual Result GetColorSetId(ColorSetId* theme);
+        virtual Result SetColorSetId(ColorSetId theme);
+        virtual Result SetBrightness(float brightness);
+        virtual Result GetAmbientLight(float* lux);
+        virtual bool ReadFile(const char* path, char* buffer, size_t capacity, size_t* size);
+        virtual Result Wait(const Waiter* waiters, s32 count, u64 timeout, s32* index);
+        using Platform::Wait;
+        virtual void SetRecording(bool enable);
+
+        virtual bool GetForegroundTitle(u64* titleId);
+        virtual bool Refresh();
+
+    private:
+        // Appends a record made of up to two parts of payload
+        void Write(u8 type, const void* payload, size_t size, const void* extra = NULL, size_t extraSize = 0);
+
+        // Writes the latest config into the trace
+        void WriteConfig();
+
+        // Opens the trace file and writes the header and the config
+        void Open();
+
+        Platform* inner;
+        ForegroundTitleSource* innerTitleSource;
+        FILE* traceFile;
+
+        // Whether the first tick passed, after which a recording would miss the start
+        bool started;
+        bool lateRequestLogged;
+
+        // Length and hash of the latest config, to only record it when it changed.
+        // Its contents stay in the buffer the Worker read them into, which is
+        // what a trace opened after reading it starts with.
+        bool configRead;
+        size_t configSize;
+        u32 configHash;
+        const char* configBuffer;
+    };
+
+    // Plays a recorded trace back, answering every call with what was recorded
+    // without touching the system, so the Worker runs at full speed. This also
+    // stands in for the ambient light sensor away from the console. Counts the
+    // decisions (theme and brightness changes) the Worker made, and how many of
+    // them, of the calls it made or of the timeouts it waited with differ from
+    // the recording. It's the title source too, telling when the title changed
+    // like the recording did.
+    class ReplayPlatform : public Platform, public ForegroundTitleSource
+    {
+    public:
+        ReplayPlatform();
+
+        // Reads the whole trace into memory
+        bool Load(const char* path);
+
+        virtual u64 GetTick();
+        virtual Result GetCurrentTime(u64* posixTime, TimeCalendarTime* calendarTime);
+        virtual Result GetColorSetId(ColorSetId* theme);
+        virtual Result SetColorSetId(ColorSetId theme);
+        virtual Result SetBrightness(float brightness);
+        virtual Result GetAmbientLight(float* lux);
+        virtual bool ReadFile(const char* path, char* buffer, size_t capacity, size_t* size);
+        virtual Result Wait(const Waiter* waiters, s32 count, u64 timeout, s32* index);
+        using Platform::Wait;
+
+        virtual bool GetForegroundTitle(u64* titleId);
+        virtual bool Refresh();
+
+        // Whether every record was played back
+        bool IsFinished();
+
+        // Stops the executor at its first wait after the trace ran out, which is
+        // where the recording ended
+        void StopAtEnd(Executor* executor) { this->executor = executor; }
+
+        u32 GetDecisionCount() const { return decisionCount; }
+        u32 GetMismatchCount() const { return mismatchCount; }
+
+    private:
+        // Copies the payload of the next record if it is of the given type and size
+        // and moves past it, counts a mismatch and returns false otherwise
+        bool Next(u8 type, void* payload, size_t size);
+
+        // Takes in any config records coming next
+        void SkipConfig();
+
+        std::vector<u8> trace;
+        size_t position;
+
+        // Last recorded tick, which stays once the trace ran out
+        u64 tick;
+
+        Executor* executor;
+
+        std::vector<char> config;
+        bool configRead;
+
+        u32 decisionCount;
+        u32 mismatchCount;
+    };
+}
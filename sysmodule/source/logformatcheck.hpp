@@ -0,0 +1,125 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <type_traits>
+
+namespace nxlightswitch
+{
+    // Types of a log call's arguments, see LOG in logger.hpp
+    template <typename... Args>
+    struct LogArgs {};
+
+    // Never called, only used to get the decayed types of the arguments
+    template <typename... Args>
+    LogArgs<typename std::decay<Args>::type...> LogArgTypes(const Args&...);
+
+    // Checks at compile time that a printf style format string matches the argument
+    // types, for LOG and RECORD to reject mismatches before they reach snprintf. It
+    // only validates, formatting still happens at runtime as before. Every
+    // conversion needs an argument of a matching type, and 64-bit
+    // integers need the l/ll/z modifier. Floats may have an l or not, like "%lf".
+    // Width and precision given as arguments ("*") aren't supported. The functions
+    // are single return statements to stay C++11 constexpr, walking the format one
+    // character per call.
+    template <typename T>
+    struct LogArgKind
+    {
+        static constexpr bool isInteger = std::is_integral<T>::value || std::is_enum<T>::value;
+        static constexpr bool isWide = sizeof(T) > 4;
+        static constexpr bool isFloat = std::is_floating_point<T>::value;
+        static constexpr bool isString = std::is_same<T, const char*>::value || std::is_same<T, char*>::value;
+        static constexpr bool isPointer = std::is_pointer<T>::value;
+
+        // Whether the argument fits the conversion character, with the given length modifier
+        static constexpr bool Matches(char conversion, bool wide)
+        {
+            return conversion == 'd' || conversion == 'i' || conversion == 'u' || conversion == 'x'
+                    || conversion == 'X' || conversion == 'o' || conversion == 'c'
+                ? isInteger && isWide == wide
+                : conversion == 'f' || conversion == 'e' || conversion == 'g' || conversion == 'E' || conversion == 'G'
+                ? isFloat
+                : conversion == 's'
+                ? isString && !wide
+                : conversion == 'p'
+                ? isPointer && !wide
+                : false;
+        }
+    };
+
+    // Helpers to skip over the parts of a conversion specification
+    constexpr bool IsLogFormatFlag(char c)
+    {
+        return c == '-' || c == '+' || c == ' ' || c == '#' || c == '0';
+    }
+
+    constexpr const char* SkipLogFormatFlags(const char* f)
+    {
+        return IsLogFormatFlag(*f) ? SkipLogFormatFlags(f + 1) : f;
+    }
+
+    constexpr const char* SkipLogFormatDigits(const char* f)
+    {
+        return *f >= '0' && *f <= '9' ? SkipLogFormatDigits(f + 1) : f;
+    }
+
+    constexpr const char* SkipLogFormatPrecision(const char* f)
+    {
+        return *f == '.' ? SkipLogFormatDigits(f + 1) : f;
+    }
+
+    // Returns the conversion character after the length modifier
+    constexpr const char* SkipLogFormatLength(const char* f)
+    {
+        return *f == 'h' || *f == 'l' || *f == 'z' ? SkipLogFormatLength(f + 1) : f;
+    }
+
+    // Points at the length modifier of the conversion starting at f (past the '%')
+    constexpr const char* FindLogFormatLength(const char* f)
+    {
+        return SkipLogFormatPrecision(SkipLogFormatDigits(SkipLogFormatFlags(f)));
+    }
+
+    // Whether the length modifier at f asks for a 64-bit integer
+    constexpr bool IsLogFormatWide(const char* f)
+    {
+        return *f == 'l' || *f == 'z';
+    }
+
+    template <typename Args>
+    struct LogFormatCheck;
+
+    // No arguments left, so only "%%" may come
+    template <>
+    struct LogFormatCheck<LogArgs<> >
+    {
+        static constexpr bool Check(const char* f)
+        {
+            return *f == '\0' ? true
+                : *f != '%' ? Check(f + 1)
+                : f[1] == '%' ? Check(f + 2)
+                : false;
+        }
+    };
+
+    template <typename T, typename... Rest>
+    struct LogFormatCheck<LogArgs<T, Rest...> >
+    {
+        static constexpr bool Check(const char* f)
+        {
+            return *f == '\0' ? false
+                : *f != '%' ? Check(f + 1)
+                : f[1] == '%' ? Check(f + 2)
+                : CheckConversion(FindLogFormatLength(f + 1));
+        }
+
+        // f points at the length modifier of the conversion for T
+        static constexpr bool CheckConversion(const char* f)
+        {
+            return LogArgKind<T>::Matches(*SkipLogFormatLength(f), IsLogFormatWide(f))
+                && LogFormatCheck<LogArgs<Rest...> >::Check(SkipLogFormatLength(f) + 1);
+        }
+    };
+}
@@ -4,85 +4,178 @@
 */
 
 #include "logger.hpp"
+#include "clock.hpp"
 #include <switch.h>
 using namespace nxlightswitch;
 
 // Needed for compiler
-Logger* Logger::singleton = NULL;
+Logger Logger::singleton;
 
-Logger* Logger::get()
+// Buffer for the log file, so opening it doesn't allocate one every time
+static char logFileBuffer[1024];
+
+Logger::Logger()
+    : droppedCount(0), dumpRequested(false), writerThread(INVALID_HANDLE), flushing(false)
 {
-    // If no singleton is existing, create a new instance
-    if (!singleton)
-    {
-        singleton = new Logger();
-    }
+    // Autoclear, as the writer handles everything there is when woken up
+    ueventCreate(&writeEvent, true);
+}
 
+Logger* Logger::get()
+{
     // Return the instance
-    return singleton;
+    return &singleton;
 }
 
 void Logger::clearLogFile()
 {
+#ifndef NXLS_BAKED_CONFIG
     // Open the file for write is all it needs to clear it
     FILE* logFile = fopen(LOG_FILE_PATH, "w");
+
+    // Happens when the SD card isn't mounted
+    if (!logFile)
+        return;
+
     fflush(logFile);
     fclose(logFile);
+#endif
+}
+
+void Logger::push(const char* text, int length)
+{
+    // Wait a bounded time for the writer when the queue is full, then rather lose the line and say so later
+    u64 tick = armGetSystemTick();
+    if (!queue.Push(tick, text, length) && !pushWhenFull(tick, text, length))
+    {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ueventSignal(&writeEvent);
 }
 
-void Logger::log(char* format, ...)
+bool Logger::pushWhenFull(u64 tick, const char* text, int length)
 {
-    // Format the log text buffer using variadic arguments
-    char logBuffer[1024];
-    va_list vaList;
-    va_start(vaList, format);
-    vsprintf(logBuffer, format, vaList);
-    va_end(vaList);
-
-    // Get the current time (UNIX time, will always start at the UNIX Epoch 01/01/1970)
-    time_t currentTime;
-    struct std::tm* timeInfo;
-    time(&currentTime);
-    timeInfo = localtime(&currentTime);
-
-    // Because of the not accurate result of the UNIX time(), try to get the console's time using libnx
-    u64 currentConsoleTime;
-    Result getTimeResult = timeGetCurrentTime(TimeType::TimeType_UserSystemClock, &currentConsoleTime);
-
-    // If that worked...
-    if (R_SUCCEEDED(getTimeResult))
+    // Nobody to wait for before the writer first ran, or once it fell behind since its last flush
+    Handle writer = writerThread.load(std::memory_order_relaxed);
+    if (writer == INVALID_HANDLE || droppedCount.load(std::memory_order_relaxed) != 0)
+        return false;
+
+    // The writer can't wait for itself, so it writes the queue out right away,
+    // unless it's logging from within a flush
+    if (writer == threadGetCurHandle())
     {
-        // ...make a TimeCalendarTime (also from libnx) out of the timestamp
-        TimeCalendarTime consoleCalendarTime;
-        TimeCalendarAdditionalInfo consoleCalendarInfo;
-        timeToCalendarTimeWithMyRule(currentConsoleTime, &consoleCalendarTime, &consoleCalendarInfo);
-
-        // Update the values of our former timeInfo with the values we got from the Switch
-        timeInfo->tm_mday = (int)consoleCalendarTime.day;
-        timeInfo->tm_mon = (int)consoleCalendarTime.month - 1; // tm_mon is 0-based
-        timeInfo->tm_year = (int)consoleCalendarTime.year - 1900; // tm_year is 0-based
-        timeInfo->tm_hour = (int)consoleCalendarTime.hour;
-        timeInfo->tm_min = (int)consoleCalendarTime.minute;
-        timeInfo->tm_sec = (int)consoleCalendarTime.second;
+        if (flushing)
+            return false;
+        flush();
+        return queue.Push(tick, text, length);
     }
 
-    // Format the time into a string
-    char timeBuffer[80];
-    strftime(timeBuffer, sizeof(timeBuffer), "%d-%m-%Y %H:%M:%S", timeInfo);
+    for (u32 i = 0; i < LOG_PUSH_RETRIES; i++)
+    {
+        ueventSignal(&writeEvent);
+        svcSleepThread(LOG_PUSH_RETRY_NS);
+        if (queue.Push(tick, text, length))
+            return true;
+    }
+    return false;
+}
 
-    // Open the log file
-    FILE* logFile = fopen(LOG_FILE_PATH, "a"); // a means append
+void Logger::flush()
+{
+    TRACE_SCOPE("Logger::flush");
+    writerThread.store(threadGetCurHandle(), std::memory_order_relaxed);
+    flushing = true;
 
-    // Print the log line to the file
-    fprintf(logFile, "%s: %s\n", timeBuffer, logBuffer);
-    
-    // Flush and close the log file
-    fflush(logFile);
-    fclose(logFile);
+    LogRecord record;
+    FILE* logFile = NULL;
+    bool notedDropped = false;
+    while (true)
+    {
+        if (!queue.Pop(&record))
+        {
+            // Once the queue is empty, note down the lines we lost and write that too
+            if (notedDropped || !pushDroppedNote())
+                break;
+            notedDropped = true;
+            continue;
+        }
+
+        // Open the log file once for all the lines there are
+        if (!logFile)
+        {
+            logFile = fopen(LOG_FILE_PATH, "a"); // a means append
+            if (!logFile)
+                break;
+            setvbuf(logFile, logFileBuffer, _IOFBF, sizeof(logFileBuffer));
+        }
+
+        // Get the time the line was logged at from our clock
+        TimeCalendarTime calendarTime;
+        if (R_FAILED(Clock::get()->getCalendarTimeAtTick(record.tick, &calendarTime)))
+        {
+            // Fall back to the UNIX time, which isn't accurate (it will always start at the UNIX Epoch 01/01/1970)
+            time_t currentTime = time(NULL);
+            struct std::tm* timeInfo = localtime(&currentTime);
+            calendarTime.year = timeInfo->tm_year + 1900;
+            calendarTime.month = timeInfo->tm_mon + 1;
+            calendarTime.day = timeInfo->tm_mday;
+            calendarTime.hour = timeInfo->tm_hour;
+            calendarTime.minute = timeInfo->tm_min;
+            calendarTime.second = timeInfo->tm_sec;
+        }
+
+        // Print the log line to the file
+        fprintf(logFile, "%02d-%02d-%04d %02d:%02d:%02d: %.*s\n", calendarTime.day, calendarTime.month, calendarTime.year,
+            calendarTime.hour, calendarTime.minute, calendarTime.second, (int)record.length, record.text);
+    }
+
+    if (logFile)
+    {
+        // Flush and close the log file
+        fflush(logFile);
+        fclose(logFile);
+    }
+
+    // Errors ask for the flight recorder, which is written here to keep the I/O on one thread
+    if (dumpRequested.exchange(false, std::memory_order_acquire))
+    {
+        FlightRecorder::get()->dump();
+    }
+    flushing = false;
 }
 
-void Logger::logError(uint32_t result)
+bool Logger::pushDroppedNote()
+{
+    u32 dropped = droppedCount.exchange(0, std::memory_order_relaxed);
+    if (!dropped)
+        return false;
+
+    // Another thread may have filled the queue again, then keep the count for next time
+    char note[64];
+    int length = snprintf(note, sizeof(note), "Dropped %d log lines, the log queue was full", (int)dropped);
+    if (!queue.Push(armGetSystemTick(), note, length))
+    {
+        droppedCount.fetch_add(dropped, std::memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+Waiter Logger::getWaiter()
+{
+    return waiterForUEvent(&writeEvent);
+}
+
+void Logger::logError(Result result, const char* file, int line)
 {
     // Fancy formatting
-    log("ERROR at %s:%s! Error code: %d", __FILE__, __LINE__, R_DESCRIPTION(result));
+    LOG("ERROR at %s:%d! Error code: %d", file, line, R_DESCRIPTION(result));
+
+    // The writer dumps the flight recorder along with the next lines
+#ifndef NXLS_BAKED_CONFIG
+    dumpRequested.store(true, std::memory_order_release);
+    ueventSignal(&writeEvent);
+#endif
 }
@@ -4,17 +4,41 @@
 */
 
 #pragma once
-#include <fstream>
-#include <cstdarg>
+#include <cstdio>
 #include <ctime>
+#include <switch.h>
+#include <atomic>
+#include "flightrecorder.hpp"
+#include "logformatcheck.hpp"
+#include "logqueue.hpp"
+#include "tracer.hpp"
 
 // Path of the log file
 #define LOG_FILE_PATH "sdmc:/NXLightSwitch.txt"
 
+// How often, and how long each time, a thread logging to a full queue waits for
+// the writer to make room before the line is dropped
+#define LOG_PUSH_RETRIES 20
+#define LOG_PUSH_RETRY_NS 1000000
+
+// Logs a line, printf style. The format has to be a string literal, it gets checked
+// against the argument types at compile time. That's validation only, the line is
+// still formatted with snprintf when logged.
+#define LOG(format, ...) \
+    do \
+    { \
+        static_assert(nxlightswitch::LogFormatCheck<decltype(nxlightswitch::LogArgTypes(__VA_ARGS__))>::Check(format), \
+            "Log arguments don't match the format: " format); \
+        nxlightswitch::Logger::get()->log(format, ##__VA_ARGS__); \
+    } while (0)
+
 namespace nxlightswitch
 {
     // This class implements a logging system to easily log to a file,
-    // which is very helpful during development
+    // which is very helpful during development. Any thread can log: lines are
+    // formatted by the thread logging them and queued, and a single writer
+    // (see flush()) appends them to the log file. A thread finding the queue
+    // full waits a little for the writer before dropping the line.
     class Logger
     {
     public:
@@ -24,14 +48,72 @@ namespace nxlightswitch
         // Clears the log file
         void clearLogFile();
 
-        // Logs with variadic arguments
-        void log(char* format, ...);
+        // Logs with variadic arguments. Use LOG instead, which checks the format.
+        // Logged lines are recorded by the flight recorder too.
+        template <typename... Args>
+        void log(const char* format, const Args&... args)
+        {
+            TRACE_SCOPE("Logger::log");
+            FlightRecorder::get()->record(format, args...);
+
+            // Baked builds don't mount the SD card, so there's no log file to queue for
+#ifndef NXLS_BAKED_CONFIG
+            // Format into a bounded buffer, marking lines which got cut off
+            char logBuffer[LOG_LINE_SIZE];
+            int length = snprintf(logBuffer, sizeof(logBuffer), format, args...);
+            if (length < 0)
+                return;
+            if (length >= (int)sizeof(logBuffer))
+            {
+                length = sizeof(logBuffer) - 1;
+                logBuffer[length - 3] = logBuffer[length - 2] = logBuffer[length - 1] = '.';
+            }
+
+            push(logBuffer, length);
+#endif
+        }
 
-        // Logs an libnx error
-        void logError(uint32_t result);
+        // Logs an libnx error, along with where it happened, and dumps the flight
+        // recorder for the context around it
+        void logError(Result result, const char* file = __builtin_FILE(), int line = __builtin_LINE());
+
+        // Writes the queued lines to the log file, and the flight recorder if an error
+        // asked for it. Only the writer thread may call this.
+        void flush();
+
+        // Signalled when there is something to flush
+        Waiter getWaiter();
 
     private:
-        // Singleton instance
-        static Logger* singleton;
+        Logger();
+
+        // Queues a formatted line for the writer, with the current tick
+        void push(const char* text, int length);
+
+        // Makes room for a line which found the queue full and queues it. The writer
+        // writes the queue out itself, other threads wake it up and wait a little.
+        // Returns false if there still was no room.
+        bool pushWhenFull(u64 tick, const char* text, int length);
+
+        // Queues a line saying how many lines were dropped, if any were. Returns
+        // true if it queued one.
+        bool pushDroppedNote();
+
+        // Lines waiting for the writer
+        LogQueue queue;
+
+        // Signalled by push() and logError() to wake the writer up
+        UEvent writeEvent;
+
+        // Lines lost because the queue was full, and whether an error asks for a dump
+        std::atomic<u32> droppedCount;
+        std::atomic<bool> dumpRequested;
+
+        // The thread which last flushed, and whether it's flushing right now
+        std::atomic<Handle> writerThread;
+        bool flushing;
+
+        // Singleton instance, static so getting it never allocates
+        static Logger singleton;
     };
 }
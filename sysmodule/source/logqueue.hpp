@@ -0,0 +1,100 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <atomic>
+#include <cstring>
+#include <switch.h>
+
+// Longest log line, longer lines get cut off
+#define LOG_LINE_SIZE 256
+
+// Number of lines the queue holds until the writer gets to them (a power of two).
+// Enough for the module's startup and an error's worth of lines without waiting.
+#define LOG_QUEUE_SIZE 64
+
+namespace nxlightswitch
+{
+    // A formatted log line and the system tick it was logged at
+    struct LogRecord
+    {
+        u64 tick;
+        u32 length;
+        char text[LOG_LINE_SIZE];
+    };
+
+    // Bounded lock-free queue of log lines, which any number of threads push to
+    // and a single writer pops from. Every cell counts how often it was written
+    // and read: in lap n (position / LOG_QUEUE_SIZE), a cell is free to push to
+    // at state 2n and ready to pop at state 2n + 1. Pushing to a full queue
+    // fails instead of waiting for the writer.
+    class LogQueue
+    {
+    public:
+        LogQueue() : pushPosition(0), popPosition(0) {}
+
+        // Adds a line. Returns false if the queue is full. Safe from any thread.
+        bool Push(u64 tick, const char* text, u32 length)
+        {
+            u64 position = pushPosition.load(std::memory_order_relaxed);
+            Cell* cell;
+            while (true)
+            {
+                cell = &cells[position % LOG_QUEUE_SIZE];
+                u64 state = cell->state.load(std::memory_order_acquire);
+                u64 freeState = position / LOG_QUEUE_SIZE * 2;
+                if (state == freeState)
+                {
+                    // Claim the cell, unless another producer got it first
+                    if (pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (state < freeState)
+                {
+                    // Last lap's line wasn't written out yet
+                    return false;
+                }
+                else
+                {
+                    position = pushPosition.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->record.tick = tick;
+            cell->record.length = length < LOG_LINE_SIZE ? length : LOG_LINE_SIZE;
+            memcpy(cell->record.text, text, cell->record.length);
+            cell->state.store(position / LOG_QUEUE_SIZE * 2 + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Takes the oldest line. Returns false if the queue is empty. Only ever call
+        // this from one thread at a time.
+        bool Pop(LogRecord* record)
+        {
+            Cell& cell = cells[popPosition % LOG_QUEUE_SIZE];
+            u64 readyState = popPosition / LOG_QUEUE_SIZE * 2 + 1;
+            if (cell.state.load(std::memory_order_acquire) != readyState)
+                return false;
+
+            *record = cell.record;
+            cell.state.store(readyState + 1, std::memory_order_release);
+            popPosition++;
+            return true;
+        }
+
+    private:
+        struct Cell
+        {
+            Cell() : state(0) {}
+
+            std::atomic<u64> state;
+            LogRecord record;
+        };
+
+        Cell cells[LOG_QUEUE_SIZE];
+        std::atomic<u64> pushPosition;
+        u64 popPosition;
+    };
+}
@@ -15,23 +15,23 @@
 #include <time.h>
 
 // Include the NXLightSwitch headers
+#include "executor.hpp"
+#include "heap.hpp"
+#include "inputtrace.hpp"
 #include "logger.hpp"
+#include "tasks.hpp"
+#include "tracer.hpp"
 #include "utils.hpp"
 #include "worker.hpp"
 
 using namespace nxlightswitch;
 
-// Taken from libstratosphere for memory management
-#define MEMORY_PAGE_SIZE 0x1000
-#define THREAD_STACK_ALIGNMENT 4 * 1024 // 4kb
-
 extern "C" 
 {
     // Sysmodules should not use applet*
     u32 __nx_applet_type = AppletType_None;
 
-    // Adjust heap size as needed
-    #define INNER_HEAP_SIZE (0x1e * MEMORY_PAGE_SIZE)
+    // Adjust heap size in heap.hpp as needed
     size_t nx_inner_heap_size = INNER_HEAP_SIZE;
     char   nx_inner_heap[INNER_HEAP_SIZE];
 
@@ -95,6 +95,27 @@ extern "C" void __attribute__((weak)) __appInit(void)
         fatalThrow(MAKERESULT(Module_Libnx, LibnxError_NotInitialized));
     }
 
+    // Initialize the lbl module, used to set the screen brightness
+    rc = lblInitialize();
+    if (R_FAILED(rc))
+    {
+        fatalThrow(MAKERESULT(Module_Libnx, LibnxError_NotInitialized));
+    }
+
+    // Initialize the pm:dmnt and pm:info modules, used to find the running title
+    rc = pmdmntInitialize();
+    if (R_FAILED(rc))
+    {
+        fatalThrow(MAKERESULT(Module_Libnx, LibnxError_NotInitialized));
+    }
+
+    rc = pminfoInitialize();
+    if (R_FAILED(rc))
+    {
+        fatalThrow(MAKERESULT(Module_Libnx, LibnxError_NotInitialized));
+    }
+
+#ifndef NXLS_BAKED_CONFIG
     // Initialize the filesystem service and make sure it was successful
     rc = fsInitialize();
     if (R_FAILED(rc))
@@ -104,6 +125,7 @@ extern "C" void __attribute__((weak)) __appInit(void)
 
     // Mount the SDMC storage
     fsdevMountSdmc();
+#endif
 }
 
 // Called (and not needed because this is a sysmodule) when the user tries to exit this app
@@ -112,9 +134,21 @@ extern "C" void __attribute__((weak)) userAppExit(void);
 // Called when the Switch requests this sysmodule to exit
 extern "C" void __attribute__((weak)) __appExit(void)
 {
+#ifndef NXLS_BAKED_CONFIG
+    // Write out whatever was logged or traced before the SD card goes away
+    Logger::get()->flush();
+    if (Tracer::enabled)
+    {
+        Tracer::get()->dump();
+    }
+
     // Cleanup and exit the services we opened
     fsdevUnmountAll();
     fsExit();
+#endif
+    pminfoExit();
+    pmdmntExit();
+    lblExit();
     setsysExit();
     setExit();
     timeExit();
@@ -125,55 +159,32 @@ extern "C" void __attribute__((weak)) __appExit(void)
 int main(int argc, char* argv[])
 {
     Logger::get()->clearLogFile();
-    Logger::get()->log("Starting NXLightSwitch");
-
-    // Create a new instance of our Worker which will handle the logic for this module
-    Worker* worker = new Worker();
-
-    // To check the time and update the system's theme, we need to run in a thread so we won't block the system
-    // The threads are libnx' system
-    static Thread workerThread;
-
-    // Size of the memory stack for the thread. Partially taken off libstratosphere, it's important to align
-    // the stack by 4KB (THREAD_STACK_ALIGNMENT) otherwise we will get a "Bad Input" error when creating the
-    // thread.
-    constexpr std::size_t workerThreadStackSize = 2 * MEMORY_PAGE_SIZE;
-    alignas(THREAD_STACK_ALIGNMENT) static std::uint8_t workerThreadStack[workerThreadStackSize];
-
-    // This is the function which runs in our thread
-    static auto workerThreadFunc = +[](void* args) {
-        // Get back the worker instance from the args we pass to this thread
-        Worker* worker = static_cast<Worker*>(args);
-
-        // This loop shouldn't end as we're always updating the worker
-        while (true)
-        {
-            // Block the thread until we should perform our next check
-            svcSleepThread(WORKER_UPDATE_INTERVAL);
-
-            // Call the worker to perform the logic
-            worker->DoWork();
-        }
-    };
-
-    // Create the thread using the thread handle, stack and function above
-    // We cast our worker instance to a void* so we can pass it to the thread
-    // 0x3f is a special thread priority for background tasks
-    // -2 indicates to run the thread on the default CPU core
-    Result r = threadCreate(&workerThread, workerThreadFunc, static_cast<void*>(worker), workerThreadStack, workerThreadStackSize, 0x3f, -2);
-    LOG_IF_ERROR(r);
-
-    // Start the thread after we created it
-    r = threadStart(&workerThread);
-    LOG_IF_ERROR(r);
-
-    // Now, this will completely block the execution of this sysmodule until the thread exits
-    r = threadWaitForExit(&workerThread);
-    LOG_IF_ERROR(r);
-
-    // Close the thread because this part of the code is only reached when the thread exited already
-    r = threadClose(&workerThread);
-    LOG_IF_ERROR(r);
+    LOG("Starting NXLightSwitch");
+
+    // The worker talks to the system through libnx, and learns about the running application from
+    // the process manager, with the inputs recorded when the config asks for it. Baked builds have
+    // no SD card to record to.
+#ifdef NXLS_BAKED_CONFIG
+    static SwitchPlatform platform;
+    static PmForegroundTitleSource titleSource;
+#else
+    static SwitchPlatform switchPlatform;
+    static PmForegroundTitleSource pmTitleSource;
+    static RecordingPlatform platform(&switchPlatform, &pmTitleSource);
+    RecordingPlatform& titleSource = platform;
+#endif
+
+    // Create our Worker which will handle the logic for this module. It holds the config buffer,
+    // so it lives next to the other statics rather than on the small heap.
+    static Worker worker(&platform, &titleSource);
+
+    // All background activities run as tasks on this thread, which wait together in one multi-wait
+    static Executor executor(&platform);
+    static ModuleTasks tasks(&worker);
+    tasks.AddTo(&executor);
+
+    // This blocks the execution of this sysmodule for as long as tasks are running, which is forever
+    executor.Run();
 
     return 0;
 }
@@ -0,0 +1,66 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "platform.hpp"
+#include "clock.hpp"
+#include <cstdio>
+using namespace nxlightswitch;
+
+u64 SwitchPlatform::GetTick()
+{
+    return armGetSystemTick();
+}
+
+Result SwitchPlatform::GetCurrentTime(u64* posixTime, TimeCalendarTime* calendarTime)
+{
+    // The clock only asks the time service now and then
+    return Clock::get()->getCurrentTime(posixTime, calendarTime);
+}
+
+Result SwitchPlatform::GetColorSetId(ColorSetId* theme)
+{
+    return setsysGetColorSetId(theme);
+}
+
+Result SwitchPlatform::SetColorSetId(ColorSetId theme)
+{
+    return setsysSetColorSetId(theme);
+}
+
+Result SwitchPlatform::SetBrightness(float brightness)
+{
+    return lblSetCurrentBrightnessSetting(brightness);
+}
+
+Result SwitchPlatform::GetAmbientLight(float* lux)
+{
+    // Bright light saturates the sensor, which still reads as bright, so the flag isn't needed
+    bool overLimit;
+    return lblGetAmbientLightSensorValue(&overLimit, lux);
+}
+
+bool SwitchPlatform::ReadFile(const char* path, char* buffer, size_t capacity, size_t* size)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    // Reading straight into the buffer, so stdio doesn't need to allocate one
+    setvbuf(file, NULL, _IONBF, 0);
+
+    // Read one byte more than fits to tell a full buffer from a too big file
+    size_t read = fread(buffer, 1, capacity, file);
+    bool tooBig = read == capacity && fgetc(file) != EOF;
+    fclose(file);
+
+    *size = read;
+    return !tooBig;
+}
+
+Result SwitchPlatform::Wait(const Waiter* waiters, s32 count, u64 timeout, s32* index)
+{
+    *index = -1;
+    return waitObjects(index, waiters, count, timeout);
+}
@@ -0,0 +1,73 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <cstddef>
+#include <switch.h>
+
+namespace nxlightswitch
+{
+    // Everything the Worker and the executor take in from the outside world goes
+    // through this interface: the system tick, clock readings, the color set, the
+    // brightness, the ambient light sensor, the config file and the time spent
+    // waiting. That way inputs can be recorded on the console and fed back into
+    // the same code later (see inputtrace.hpp).
+    class Platform
+    {
+    public:
+        virtual ~Platform() {}
+
+        // Gets the system tick, which the executor takes its deadlines from
+        virtual u64 GetTick() = 0;
+
+        // Gets the console's time, as POSIX time and as local calendar time
+        virtual Result GetCurrentTime(u64* posixTime, TimeCalendarTime* calendarTime) = 0;
+
+        // Gets/sets the system's color set (the theme)
+        virtual Result GetColorSetId(ColorSetId* theme) = 0;
+        virtual Result SetColorSetId(ColorSetId theme) = 0;
+
+        // Sets the screen brightness (0 to 1)
+        virtual Result SetBrightness(float brightness) = 0;
+
+        // Reads the ambient light sensor (in lux)
+        virtual Result GetAmbientLight(float* lux) = 0;
+
+        // Reads a whole file into the given buffer. Returns false if it couldn't be
+        // read or doesn't fit. A file which doesn't fit sets size to the capacity.
+        virtual bool ReadFile(const char* path, char* buffer, size_t capacity, size_t* size) = 0;
+
+        // Waits for one of the waiters to be signalled or the timeout to pass, like
+        // waitObjects(). index is set to the waiter which was signalled.
+        virtual Result Wait(const Waiter* waiters, s32 count, u64 timeout, s32* index) = 0;
+
+        // Waits for a single waiter, like waitSingle()
+        Result Wait(Waiter waiter, u64 timeout)
+        {
+            s32 index;
+            return Wait(&waiter, 1, timeout, &index);
+        }
+
+        // Turns recording of the inputs on or off, if this platform can record them
+        virtual void SetRecording(bool enable) {}
+    };
+
+    // The real thing, talking to the system services through libnx
+    class SwitchPlatform : public Platform
+    {
+    public:
+        virtual u64 GetTick();
+        virtual Result GetCurrentTime(u64* posixTime, TimeCalendarTime* calendarTime);
+        virtual Result GetColorSetId(ColorSetId* theme);
+        virtual Result SetColorSetId(ColorSetId theme);
+        virtual Result SetBrightness(float brightness);
+        virtual Result GetAmbientLight(float* lux);
+        virtual bool ReadFile(const char* path, char* buffer, size_t capacity, size_t* size);
+        virtual Result Wait(const Waiter* waiters, s32 count, u64 timeout, s32* index);
+
+        // Keeps the single waiter overload visible next to the override
+        using Platform::Wait;
+    };
+}
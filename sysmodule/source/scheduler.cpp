@@ -0,0 +1,267 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "scheduler.hpp"
+using namespace nxlightswitch;
+
+// Splits minutes into 64 minute blocks
+#define BLOCK_SHIFT 6
+
+Scheduler::Scheduler()
+{
+    Reset(0);
+}
+
+void Scheduler::Reset(u64 nowMinute)
+{
+    actions.clear();
+    freeActions = -1;
+    for (s32 i = 0; i < ListCount; i++)
+        heads[i] = -1;
+
+    level0Bits = 0;
+    for (u32 i = 0; i < SCHEDULER_LEVEL1_SLOTS / 64; i++)
+        level1Bits[i] = 0;
+
+    currentMinute = nowMinute;
+}
+
+ScheduleHandle Scheduler::Schedule(u64 minute, u32 periodMinutes, ScheduledActionFunc func, void* context, u32 argument)
+{
+    // Reuse a cancelled action if there is one
+    s32 index = freeActions;
+    if (index >= 0)
+    {
+        freeActions = actions[index].next;
+    }
+    else
+    {
+        index = (s32)actions.size();
+        actions.push_back(Action());
+    }
+
+    Action& action = actions[index];
+    action.expiry = minute;
+    action.period = periodMinutes;
+    action.func = func;
+    action.context = context;
+    action.argument = argument;
+    Insert(index);
+
+    return index;
+}
+
+void Scheduler::Cancel(ScheduleHandle handle)
+{
+    if (handle < 0 || handle >= (s32)actions.size() || actions[handle].list < 0)
+        return;
+
+    Unlink(handle);
+    actions[handle].next = freeActions;
+    freeActions = handle;
+}
+
+bool Scheduler::GetNextExpiry(u64* minute) const
+{
+    // Level 0 only holds actions of the current block, each slot being one minute
+    if (level0Bits)
+    {
+        *minute = (currentMinute & ~(u64)(SCHEDULER_LEVEL0_SLOTS - 1)) | (u64)__builtin_ctzll(level0Bits);
+        return true;
+    }
+
+    // Otherwise find the next non-empty block, walking the level 1 bitmap word by word
+    // starting right after the current block's slot, wrapping around once
+    u32 start = (u32)((currentMinute >> BLOCK_SHIFT) + 1) % SCHEDULER_LEVEL1_SLOTS;
+    u32 words = SCHEDULER_LEVEL1_SLOTS / 64;
+    for (u32 i = 0; i <= words; i++)
+    {
+        u32 word = (start / 64 + i) % words;
+        u64 bits = level1Bits[word];
+        if (i == 0)
+            bits &= ~0ull << (start % 64);
+        else if (i == words)
+            bits &= ~(~0ull << (start % 64));
+
+        if (bits)
+        {
+            *minute = GetListMinimum(Level1List + (s32)(word * 64 + __builtin_ctzll(bits)));
+            return true;
+        }
+    }
+
+    // Lastly, actions too far in the future for the wheel
+    if (heads[OverflowList] >= 0)
+    {
+        *minute = GetListMinimum(OverflowList);
+        return true;
+    }
+
+    return false;
+}
+
+void Scheduler::Advance(u64 nowMinute)
+{
+    u64 nextMinute;
+    while (GetNextExpiry(&nextMinute) && nextMinute <= nowMinute)
+    {
+        MoveTo(nextMinute);
+
+        // Everything in this level 0 slot is due now
+        s32 list = (s32)(nextMinute % SCHEDULER_LEVEL0_SLOTS);
+        while (heads[list] >= 0)
+        {
+            s32 index = heads[list];
+            Action& action = actions[index];
+            ScheduledActionFunc func = action.func;
+            void* context = action.context;
+            u32 argument = action.argument;
+
+            Unlink(index);
+            if (action.period)
+            {
+                // Skip over runs which were missed while the wheel stood still
+                action.expiry += action.period;
+                if (action.expiry <= nowMinute)
+                    action.expiry += ((nowMinute - action.expiry) / action.period + 1) * action.period;
+                Insert(index);
+            }
+            else
+            {
+                action.next = freeActions;
+                freeActions = index;
+            }
+
+            // The action may schedule or cancel actions itself, so call it last
+            func(context, argument);
+        }
+    }
+
+    MoveTo(nowMinute);
+}
+
+void Scheduler::Insert(s32 index)
+{
+    Action& action = actions[index];
+
+    // Actions due in the past run as soon as possible
+    if (action.expiry < currentMinute)
+        action.expiry = currentMinute;
+
+    u64 block = action.expiry >> BLOCK_SHIFT;
+    u64 currentBlock = currentMinute >> BLOCK_SHIFT;
+    s32 list;
+    if (block == currentBlock)
+    {
+        list = (s32)(action.expiry % SCHEDULER_LEVEL0_SLOTS);
+        level0Bits |= 1ull << list;
+    }
+    else if (block - currentBlock < SCHEDULER_LEVEL1_SLOTS)
+    {
+        u32 slot = (u32)(block % SCHEDULER_LEVEL1_SLOTS);
+        list = Level1List + slot;
+        level1Bits[slot / 64] |= 1ull << (slot % 64);
+    }
+    else
+    {
+        list = OverflowList;
+    }
+
+    action.list = list;
+    action.prev = -1;
+    action.next = heads[list];
+    if (action.next >= 0)
+        actions[action.next].prev = index;
+    heads[list] = index;
+}
+
+void Scheduler::Unlink(s32 index)
+{
+    Action& action = actions[index];
+    s32 list = action.list;
+
+    if (action.prev >= 0)
+        actions[action.prev].next = action.next;
+    else
+        heads[list] = action.next;
+    if (action.next >= 0)
+        actions[action.next].prev = action.prev;
+    action.list = -1;
+
+    // Keep the bitmaps in sync with the slots
+    if (heads[list] < 0)
+    {
+        if (list < Level1List)
+        {
+            level0Bits &= ~(1ull << list);
+        }
+        else if (list < OverflowList)
+        {
+            u32 slot = (u32)(list - Level1List);
+            level1Bits[slot / 64] &= ~(1ull << (slot % 64));
+        }
+    }
+}
+
+void Scheduler::MoveTo(u64 minute)
+{
+    u64 previousBlock = currentMinute >> BLOCK_SHIFT;
+    currentMinute = minute;
+    if ((minute >> BLOCK_SHIFT) == previousBlock)
+        return;
+
+    // Entering a new block: its level 1 slot only holds actions of this block,
+    // as every block in between was empty, so they all move down to level 0
+    s32 list = Level1List + (s32)((minute >> BLOCK_SHIFT) % SCHEDULER_LEVEL1_SLOTS);
+    while (heads[list] >= 0)
+    {
+        s32 index = heads[list];
+        Unlink(index);
+        Insert(index);
+    }
+
+    // Pull in actions which now fit into the wheel
+    s32 index = heads[OverflowList];
+    while (index >= 0)
+    {
+        s32 next = actions[index].next;
+        if ((actions[index].expiry >> BLOCK_SHIFT) - (minute >> BLOCK_SHIFT) < SCHEDULER_LEVEL1_SLOTS)
+        {
+            Unlink(index);
+            Insert(index);
+        }
+        index = next;
+    }
+}
+
+u64 Scheduler::GetListMinimum(s32 list) const
+{
+    u64 minimum = ~0ull;
+    for (s32 index = heads[list]; index >= 0; index = actions[index].next)
+    {
+        if (actions[index].expiry < minimum)
+            minimum = actions[index].expiry;
+    }
+    return minimum;
+}
+
+u64 Scheduler::MinuteFromCalendar(int year, int month, int day, int hour, int minute)
+{
+    // Days since the epoch of a proleptic Gregorian date (Howard Hinnant's days_from_civil)
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    s64 days = (s64)era * 146097 + dayOfEra - 719468;
+
+    return (u64)(days * MINUTES_PER_DAY + hour * 60 + minute);
+}
+
+u32 Scheduler::MinuteOfWeek(u64 minute)
+{
+    // The epoch was a Thursday, three days after a Monday
+    return (u32)((minute + 3 * MINUTES_PER_DAY) % MINUTES_PER_WEEK);
+}
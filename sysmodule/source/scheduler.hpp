@@ -0,0 +1,114 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <vector>
+#include <switch.h>
+
+// Handy durations, in minutes
+#define MINUTES_PER_DAY 1440
+#define MINUTES_PER_WEEK 10080
+
+// Slot counts of the two wheel levels. Level 0 has one slot per minute of the
+// current 64 minute block, level 1 one slot per 64 minute block, so together
+// they cover a bit more than 11 days ahead, which is enough for weekly actions.
+#define SCHEDULER_LEVEL0_SLOTS 64
+#define SCHEDULER_LEVEL1_SLOTS 256
+
+namespace nxlightswitch
+{
+    // Function run when a scheduled action becomes due
+    typedef void (*ScheduledActionFunc)(void* context, u32 argument);
+
+    // Identifies a scheduled action, -1 means none
+    typedef s32 ScheduleHandle;
+
+    // Runs any number of independent actions at given minutes, optionally repeating
+    // them with a fixed period. Actions live in a hierarchical timer wheel, so
+    // scheduling and cancelling are O(1). Finding the next expiry finds the first
+    // non-empty slot through bitmaps, but then scans that slot, which holds every
+    // action of its 64 minute block, or the overflow list past the wheel. Entering
+    // a new block scans the overflow list too. With the module's handful of
+    // actions per day that's a few entries at most.
+    // Time is counted in local minutes since the UNIX epoch (see MinuteFromCalendar).
+    class Scheduler
+    {
+    public:
+        Scheduler();
+
+        // Drops all actions and sets the wheel's current minute
+        void Reset(u64 nowMinute);
+
+        // Schedules an action at the given minute. If periodMinutes isn't 0, the action
+        // is rescheduled that many minutes later each time it ran.
+        ScheduleHandle Schedule(u64 minute, u32 periodMinutes, ScheduledActionFunc func, void* context, u32 argument);
+
+        // Removes a scheduled action
+        void Cancel(ScheduleHandle handle);
+
+        // Gets the minute the earliest action is due at. Returns false if nothing is scheduled.
+        bool GetNextExpiry(u64* minute) const;
+
+        // Moves the wheel forward to the given minute, running every action due until then
+        // in order. Periodic actions which were due several times only run once.
+        void Advance(u64 nowMinute);
+
+        // Returns the wheel's current minute
+        u64 GetCurrentMinute() const { return currentMinute; }
+
+        // Converts a calendar date and time to minutes since the UNIX epoch
+        static u64 MinuteFromCalendar(int year, int month, int day, int hour, int minute);
+
+        // Returns the minute within the week (0 is Monday 00:00) of the given minute
+        static u32 MinuteOfWeek(u64 minute);
+
+    private:
+        // Lists 0-63 are the level 0 slots, the next 256 the level 1 slots, and the
+        // last one holds actions too far ahead for the wheel
+        enum
+        {
+            Level1List = SCHEDULER_LEVEL0_SLOTS,
+            OverflowList = SCHEDULER_LEVEL0_SLOTS + SCHEDULER_LEVEL1_SLOTS,
+            ListCount = OverflowList + 1
+        };
+
+        struct Action
+        {
+            u64 expiry;
+            u32 period;
+            ScheduledActionFunc func;
+            void* context;
+            u32 argument;
+
+            // Intrusive list links, and the list this action is in (-1 if unused)
+            s32 prev;
+            s32 next;
+            s32 list;
+        };
+
+        // Puts an action into the list matching its expiry
+        void Insert(s32 index);
+
+        // Takes an action out of its list
+        void Unlink(s32 index);
+
+        // Sets the current minute without running anything, cascading level 1 when
+        // a new 64 minute block is entered
+        void MoveTo(u64 minute);
+
+        // Scans a list for its earliest expiry, linear in the list's length
+        u64 GetListMinimum(s32 list) const;
+
+        std::vector<Action> actions;
+        s32 freeActions;
+        s32 heads[ListCount];
+
+        // One bit per non-empty slot, to find the next expiry without walking slots
+        u64 level0Bits;
+        u64 level1Bits[SCHEDULER_LEVEL1_SLOTS / 64];
+
+        u64 currentMinute;
+    };
+}
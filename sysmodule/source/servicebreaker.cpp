@@ -0,0 +1,83 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "servicebreaker.hpp"
+#include "logger.hpp"
+using namespace nxlightswitch;
+
+ServiceBreaker::ServiceBreaker(const char* name, Platform* platform)
+    : name(name), platform(platform), state(State_Closed), failureCount(0), skippedCount(0), lastResult(0),
+      backoff(SERVICE_BREAKER_INITIAL_BACKOFF), retryTick(0), jitterState(14695981039346656037ull)
+{
+    // Every breaker gets its own sequence, so they still don't line up
+    for (const char* c = name; *c; c++)
+        jitterState = (jitterState ^ (u8)*c) * 1099511628211ull;
+}
+
+bool ServiceBreaker::ShouldAttempt()
+{
+    if (state != State_Open)
+        return true;
+
+    // Let one retry through once the backoff ran out
+    if (platform->GetTick() >= retryTick)
+    {
+        state = State_HalfOpen;
+        return true;
+    }
+
+    skippedCount++;
+    return false;
+}
+
+void ServiceBreaker::OnResult(Result result, const char* file, int line)
+{
+    if (R_SUCCEEDED(result))
+    {
+        if (failureCount >= SERVICE_BREAKER_THRESHOLD)
+        {
+            LOG("%s recovered after %d failures (%d calls skipped)", name, failureCount, skippedCount);
+        }
+
+        state = State_Closed;
+        failureCount = 0;
+        skippedCount = 0;
+        backoff = SERVICE_BREAKER_INITIAL_BACKOFF;
+        return;
+    }
+
+    failureCount++;
+    lastResult = result;
+
+    if (state == State_HalfOpen)
+    {
+        // The retry failed too, wait longer next time
+        backoff = backoff * 2 > SERVICE_BREAKER_MAX_BACKOFF ? SERVICE_BREAKER_MAX_BACKOFF : backoff * 2;
+        Open();
+        LOG("ERROR: %s still failing after %d attempts (%d calls skipped), last error code: %d, retrying in %ds",
+            name, failureCount, skippedCount, R_DESCRIPTION(result), (int)(backoff / 1000000000ull));
+    }
+    else if (failureCount == SERVICE_BREAKER_THRESHOLD)
+    {
+        Open();
+        LOG("ERROR: %s failed %d times in a row, last error code: %d, suspending it for %ds",
+            name, failureCount, R_DESCRIPTION(result), (int)(backoff / 1000000000ull));
+    }
+    else if (failureCount < SERVICE_BREAKER_THRESHOLD)
+    {
+        Logger::get()->logError(result, file, line);
+    }
+}
+
+void ServiceBreaker::Open()
+{
+    // Spread retries out a bit so several failing services don't line up (xorshift64)
+    jitterState ^= jitterState << 13;
+    jitterState ^= jitterState >> 7;
+    jitterState ^= jitterState << 17;
+    u64 jitter = jitterState % (backoff / 2 + 1);
+    retryTick = platform->GetTick() + armNsToTicks(backoff - backoff / 4 + jitter);
+    state = State_Open;
+}
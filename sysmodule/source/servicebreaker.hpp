@@ -0,0 +1,65 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <switch.h>
+#include "platform.hpp"
+
+// Consecutive failures after which a service call is suspended
+#define SERVICE_BREAKER_THRESHOLD 3
+
+// Suspension after the breaker opens, doubled on every failed retry up to the maximum (in nanoseconds)
+#define SERVICE_BREAKER_INITIAL_BACKOFF 30000000000ull
+#define SERVICE_BREAKER_MAX_BACKOFF 3600000000000ull
+
+namespace nxlightswitch
+{
+    // Tracks the failures of one service call. After a few failures in a row the
+    // breaker opens and the call is skipped entirely for an exponentially growing,
+    // jittered backoff, after which one retry is let through. Instead of one log
+    // line per failure, it logs when it opens, when a retry fails and when the
+    // service recovers. The backoff is timed by the platform's tick and the jitter
+    // is seeded from the name, so a replay retries at the same time as the recording.
+    class ServiceBreaker
+    {
+    public:
+        // The name is used in the log and must be a string literal
+        ServiceBreaker(const char* name, Platform* platform);
+
+        // Whether the call should be made now. False while the breaker is open.
+        bool ShouldAttempt();
+
+        // Reports the result of a call which was made. Errors below the threshold are
+        // logged with the caller's location.
+        void OnResult(Result result, const char* file = __builtin_FILE(), int line = __builtin_LINE());
+
+    private:
+        enum State
+        {
+            State_Closed,
+            State_Open,
+            State_HalfOpen
+        };
+
+        // Opens the breaker for the current backoff, plus or minus 25%
+        void Open();
+
+        const char* name;
+        Platform* platform;
+        State state;
+
+        // Failures in a row, and calls skipped since the breaker opened
+        u32 failureCount;
+        u32 skippedCount;
+        Result lastResult;
+
+        // Current backoff, and the system tick the next retry is allowed at
+        u64 backoff;
+        u64 retryTick;
+
+        // State of the generator for the jitter
+        u64 jitterState;
+    };
+}
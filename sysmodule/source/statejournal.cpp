@@ -0,0 +1,116 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "statejournal.hpp"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+using namespace nxlightswitch;
+
+// Marks valid records ("NXLS")
+#define STATE_RECORD_MAGIC 0x534C584E
+
+static_assert(sizeof(StateRecord) == 32, "StateRecord must stay 32 bytes, the journal layout depends on it");
+
+StateJournal::StateJournal()
+    : sequence(0), loaded(false)
+{
+}
+
+bool StateJournal::Load(StateRecord* record)
+{
+    FILE* journalFile = fopen(STATE_JOURNAL_PATH, "rb");
+    if (!journalFile)
+        return false;
+
+    StateRecord slots[STATE_JOURNAL_SLOTS];
+    size_t slotCount = fread(slots, sizeof(StateRecord), STATE_JOURNAL_SLOTS, journalFile);
+    fclose(journalFile);
+
+    bool found = FindNewest(slots, slotCount, record);
+    sequence = found ? record->sequence : 0;
+    loaded = true;
+    return found;
+}
+
+bool StateJournal::Write(ColorSetId theme, u64 minute, u32 configFingerprint, bool overridden)
+{
+    // Create the journal with all its slots up front, so updates never grow it
+    FILE* journalFile = fopen(STATE_JOURNAL_PATH, "r+b");
+    bool created = false;
+    if (!journalFile)
+    {
+        journalFile = fopen(STATE_JOURNAL_PATH, "w+b");
+        if (!journalFile)
+            return false;
+        created = true;
+    }
+
+    // Everything is written in one go, so stdio doesn't need to allocate a buffer
+    setvbuf(journalFile, NULL, _IONBF, 0);
+    if (created)
+    {
+        StateRecord empty[STATE_JOURNAL_SLOTS];
+        memset(empty, 0, sizeof(empty));
+        fwrite(empty, sizeof(StateRecord), STATE_JOURNAL_SLOTS, journalFile);
+        sequence = 0;
+        loaded = true;
+    }
+    else if (!loaded)
+    {
+        // Carry on from the newest record there is, which may be from before a restart
+        StateRecord slots[STATE_JOURNAL_SLOTS];
+        StateRecord newest;
+        size_t slotCount = fread(slots, sizeof(StateRecord), STATE_JOURNAL_SLOTS, journalFile);
+        sequence = FindNewest(slots, slotCount, &newest) ? newest.sequence : 0;
+        loaded = true;
+    }
+
+    StateRecord record;
+    memset(&record, 0, sizeof(record));
+    record.magic = STATE_RECORD_MAGIC;
+    record.sequence = sequence + 1;
+    record.minute = minute;
+    record.configFingerprint = configFingerprint;
+    record.theme = (u8)theme;
+    record.overridden = overridden ? 1 : 0;
+    record.checksum = Checksum(record);
+
+    // Never touch the slot holding the newest record
+    fseek(journalFile, (long)((record.sequence % STATE_JOURNAL_SLOTS) * sizeof(StateRecord)), SEEK_SET);
+    bool written = fwrite(&record, sizeof(record), 1, journalFile) == 1;
+    fflush(journalFile);
+    fclose(journalFile);
+
+    if (written)
+        sequence = record.sequence;
+
+    return written;
+}
+
+u32 StateJournal::Checksum(const StateRecord& record)
+{
+    return crc32Calculate(&record, offsetof(StateRecord, checksum));
+}
+
+bool StateJournal::IsValid(const StateRecord& record)
+{
+    return record.magic == STATE_RECORD_MAGIC && record.checksum == Checksum(record);
+}
+
+bool StateJournal::FindNewest(const StateRecord* slots, size_t slotCount, StateRecord* record)
+{
+    // The newest valid record wins, a torn slot simply fails its checksum
+    bool found = false;
+    for (size_t i = 0; i < slotCount; i++)
+    {
+        if (IsValid(slots[i]) && (!found || (s32)(slots[i].sequence - record->sequence) > 0))
+        {
+            *record = slots[i];
+            found = true;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,66 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <switch.h>
+
+// Path of the state journal
+#define STATE_JOURNAL_PATH "sdmc:/config/NXLightSwitch/State.bin"
+
+// Number of record slots in the journal, written in turns
+#define STATE_JOURNAL_SLOTS 2
+
+namespace nxlightswitch
+{
+    // What NXLightSwitch last did, as stored in the journal
+    struct StateRecord
+    {
+        u32 magic;
+        u32 sequence;
+
+        // Local minute (see Scheduler::MinuteFromCalendar) the record was written at
+        u64 minute;
+
+        // Fingerprint of the config the theme was picked with
+        u32 configFingerprint;
+
+        // Last theme NXLightSwitch applied, and whether the user has since overridden it by hand
+        u8 theme;
+        u8 overridden;
+        u16 reserved;
+        u32 reserved2;
+
+        // CRC32 of everything above
+        u32 checksum;
+    };
+
+    // Keeps the module's state across restarts in a tiny preallocated file. Each
+    // update is a single in-place write of one checksummed record, alternating
+    // between two slots, so a torn write only ever loses the newest record and
+    // the previous one is still there to recover from.
+    class StateJournal
+    {
+    public:
+        StateJournal();
+
+        // Reads the newest valid record. Returns false if there is none.
+        bool Load(StateRecord* record);
+
+        // Writes a new record into the slot after the newest one. Reads the slots
+        // first if Load() didn't, so the newest record is never overwritten.
+        bool Write(ColorSetId theme, u64 minute, u32 configFingerprint, bool overridden);
+
+    private:
+        static u32 Checksum(const StateRecord& record);
+        static bool IsValid(const StateRecord& record);
+
+        // Finds the newest valid record of the given slots. Returns false if there is none.
+        static bool FindNewest(const StateRecord* slots, size_t slotCount, StateRecord* record);
+
+        // Sequence number of the newest record, and whether it was read from the journal
+        u32 sequence;
+        bool loaded;
+    };
+}
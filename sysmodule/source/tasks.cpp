@@ -0,0 +1,56 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "tasks.hpp"
+#include "flightrecorder.hpp"
+#include "logger.hpp"
+#include "tracer.hpp"
+using namespace nxlightswitch;
+
+bool WorkerTask::Step(bool signalled)
+{
+    // Call the worker to perform the logic
+    worker->DoWork();
+
+    // Wait until we should perform our next check, which also looks for a new foreground application
+    Sleep(worker->GetWaitTimeout(WORKER_UPDATE_INTERVAL));
+    return true;
+}
+
+bool LogWriterTask::Step(bool signalled)
+{
+    Logger::get()->flush();
+    WaitFor(Logger::get()->getWaiter(), UINT64_MAX);
+    return true;
+}
+
+bool DumpRequestTask::Step(bool signalled)
+{
+    FILE* requestFile = fopen(DUMP_REQUEST_PATH, "r");
+    if (requestFile)
+    {
+        fclose(requestFile);
+        remove(DUMP_REQUEST_PATH);
+
+        FlightRecorder::get()->dump();
+        if (Tracer::enabled)
+            Tracer::get()->dump();
+    }
+
+    Sleep(DUMP_REQUEST_INTERVAL);
+    return true;
+}
+
+void ModuleTasks::AddTo(Executor* executor)
+{
+#ifdef NXLS_BAKED_CONFIG
+    executor->Add(&workerTask);
+#else
+    // The other tasks write to the SD card, which baked builds don't mount
+    executor->Add(&logWriterTask);
+    executor->Add(&workerTask);
+    executor->Add(&dumpRequestTask);
+#endif
+}
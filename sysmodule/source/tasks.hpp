@@ -0,0 +1,61 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include "executor.hpp"
+#include "worker.hpp"
+
+// Creating this file requests a dump of the flight recorder and the trace
+#define DUMP_REQUEST_PATH "sdmc:/config/NXLightSwitch/Dump"
+
+// Time between two looks for DUMP_REQUEST_PATH (in nanoseconds)
+#define DUMP_REQUEST_INTERVAL 6e+10
+
+namespace nxlightswitch
+{
+    // Runs the worker's logic whenever it is due
+    class WorkerTask : public Task
+    {
+    public:
+        WorkerTask(Worker* worker) : worker(worker) {}
+
+        virtual bool Step(bool signalled);
+
+    private:
+        Worker* worker;
+    };
+
+    // Writes the log lines other tasks (or threads) logged
+    class LogWriterTask : public Task
+    {
+    public:
+        virtual bool Step(bool signalled);
+    };
+
+    // Writes the flight recorder out, and the trace while tracing is on, once
+    // DUMP_REQUEST_PATH was created. It only looks for the file every
+    // DUMP_REQUEST_INTERVAL, as that costs a request to the SD card.
+    class DumpRequestTask : public Task
+    {
+    public:
+        virtual bool Step(bool signalled);
+    };
+
+    // All tasks of the module. They are always added in the same order, so a
+    // replay waits on the same waiters in the same order as the recording.
+    class ModuleTasks
+    {
+    public:
+        ModuleTasks(Worker* worker) : workerTask(worker) {}
+
+        // Adds the tasks to the executor
+        void AddTo(Executor* executor);
+
+    private:
+        LogWriterTask logWriterTask;
+        WorkerTask workerTask;
+        DumpRequestTask dumpRequestTask;
+    };
+}
@@ -0,0 +1,335 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "titlerules.hpp"
+#include "logger.hpp"
+#include "utils.hpp"
+#include "ini/ini.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+using namespace nxlightswitch;
+
+// Average number of keys per first-level bucket
+#define TITLE_RULES_BUCKET_SIZE 4
+
+// Most keys a single bucket may get, more would take too long to place anyway
+#define TITLE_RULES_MAX_BUCKET 32
+
+// Upper bound of displacement seeds tried for a single bucket
+#define TITLE_RULES_MAX_SEED (1 << 20)
+
+// The build indexes rules with u16s
+static_assert(TITLE_RULES_MAX_COUNT <= 0xFFFF, "Title rules are indexed with u16");
+
+// Number of u32 words a bit per rule takes
+static size_t BitWords(size_t count)
+{
+    return (count + 31) / 32;
+}
+
+static bool GetBit(const u32* bits, size_t index)
+{
+    return (bits[index / 32] >> (index % 32)) & 1;
+}
+
+static void SetBit(u32* bits, size_t index, bool value)
+{
+    if (value)
+        bits[index / 32] |= 1u << (index % 32);
+    else
+        bits[index / 32] &= ~(1u << (index % 32));
+}
+
+// Where the rules file's handler puts up to `capacity` rules, it only counts
+// them while titleIds is NULL
+struct TitleRulesParse
+{
+    u64* titleIds;
+    u32* darkBits;
+    size_t capacity;
+    size_t count;
+};
+
+// Called by ini_parse_stream for every name=value pair in the rules file
+static int TitleRulesHandler(void* user, const char* section, const char* name, const char* value)
+{
+    // Only look at the [TitleRules] section
+    if (strcasecmp(section, "TitleRules") != 0)
+        return 1;
+
+    char* end;
+    u64 titleId = strtoull(name, &end, 16);
+    if (end == name || *end != '\0')
+        return 0;
+
+    bool dark;
+    if (strcasecmp(value, "light") == 0)
+        dark = false;
+    else if (strcasecmp(value, "dark") == 0)
+        dark = true;
+    else
+        return 0;
+
+    // The second pass stops at the count the first one found, should the file grow in between
+    TitleRulesParse* parse = static_cast<TitleRulesParse*>(user);
+    if (parse->titleIds && parse->count < parse->capacity)
+    {
+        parse->titleIds[parse->count] = titleId;
+        SetBit(parse->darkBits, parse->count, dark);
+    }
+    parse->count++;
+    return 1;
+}
+
+TitleRules::TitleRules()
+    : table(NULL), count(0), bucketCount(0), titleIds(NULL), darkBits(NULL), displacements(NULL)
+{
+}
+
+TitleRules::~TitleRules()
+{
+    Clear();
+}
+
+bool TitleRules::Load(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return false;
+
+    // Count the rules first, so a file with too many leaves the loaded ones alone
+    TitleRulesParse parse = {};
+    int error = ini_parse_stream(ReadIniLine, file, TitleRulesHandler, &parse);
+    if (parse.count > TITLE_RULES_MAX_COUNT)
+    {
+        LOG("Title rules file lists %d rules, at most %d are supported", (int)parse.count, TITLE_RULES_MAX_COUNT);
+        fclose(file);
+        return false;
+    }
+    if (error)
+        LOG("Ignored invalid title rule at line %d", error);
+    if (parse.count == 0)
+    {
+        fclose(file);
+        return BuildTable(NULL, NULL, 0);
+    }
+
+    // Then take them in, into one block holding the title IDs and their themes
+    size_t ruleCount = parse.count;
+    void* rules = malloc(ruleCount * sizeof(u64) + BitWords(ruleCount) * sizeof(u32));
+    if (!rules)
+    {
+        LOG("Not enough memory to load %d title rules", (int)ruleCount);
+        fclose(file);
+        return false;
+    }
+    parse.titleIds = static_cast<u64*>(rules);
+    parse.darkBits = reinterpret_cast<u32*>(parse.titleIds + ruleCount);
+    parse.capacity = ruleCount;
+    parse.count = 0;
+    rewind(file);
+    ini_parse_stream(ReadIniLine, file, TitleRulesHandler, &parse);
+    fclose(file);
+
+    bool built = BuildTable(parse.titleIds, parse.darkBits, std::min(parse.count, ruleCount));
+    free(rules);
+    return built;
+}
+
+bool TitleRules::Build(const std::vector<TitleRule>& rules)
+{
+    std::vector<u64> ruleTitleIds(rules.size());
+    std::vector<u32> ruleDarkBits(BitWords(rules.size()));
+    for (size_t i = 0; i < rules.size(); i++)
+    {
+        ruleTitleIds[i] = rules[i].titleId;
+        SetBit(ruleDarkBits.data(), i, rules[i].theme == ColorSetId_Dark);
+    }
+    return BuildTable(ruleTitleIds.data(), ruleDarkBits.data(), rules.size());
+}
+
+bool TitleRules::BuildTable(const u64* ruleTitleIds, const u32* ruleDarkBits, size_t ruleCount)
+{
+    Clear();
+    if (ruleCount == 0)
+        return true;
+    if (ruleCount > TITLE_RULES_MAX_COUNT)
+    {
+        LOG("Title rules file lists %d rules, at most %d are supported", (int)ruleCount, TITLE_RULES_MAX_COUNT);
+        return false;
+    }
+
+    // Scratch space for the build, all in one block: the rules in title ID order,
+    // the rules grouped by bucket, where each bucket starts in that grouping, the
+    // order the buckets get placed in, and which slots are taken
+    size_t maxBuckets = (ruleCount + TITLE_RULES_BUCKET_SIZE - 1) / TITLE_RULES_BUCKET_SIZE;
+    size_t scratchSize = (2 * ruleCount + 2 * maxBuckets + 1) * sizeof(u16) + BitWords(ruleCount) * sizeof(u32);
+    u32* taken = static_cast<u32*>(malloc(scratchSize));
+    if (!taken)
+    {
+        LOG("Not enough memory to build the title rules table for %d rules", (int)ruleCount);
+        return false;
+    }
+    u16* sorted = reinterpret_cast<u16*>(taken + BitWords(ruleCount));
+    u16* grouped = sorted + ruleCount;
+    u16* bucketStarts = grouped + ruleCount;
+    u16* order = bucketStarts + maxBuckets + 1;
+
+    // Drop duplicate title IDs, keeping the last rule listed for each
+    for (size_t i = 0; i < ruleCount; i++)
+        sorted[i] = (u16)i;
+    std::sort(sorted, sorted + ruleCount, [ruleTitleIds](u16 a, u16 b) {
+        return ruleTitleIds[a] != ruleTitleIds[b] ? ruleTitleIds[a] < ruleTitleIds[b] : a < b;
+    });
+    size_t unique = 0;
+    for (size_t i = 0; i < ruleCount; i++)
+    {
+        if (unique > 0 && ruleTitleIds[sorted[unique - 1]] == ruleTitleIds[sorted[i]])
+            sorted[unique - 1] = sorted[i];
+        else
+            sorted[unique++] = sorted[i];
+    }
+
+    // Split the keys into buckets using the first-level hash: count the keys per
+    // bucket, turn the counts into where each bucket ends, and fill the buckets
+    // from their ends, after which each one's end moved to its start
+    size_t newBucketCount = (unique + TITLE_RULES_BUCKET_SIZE - 1) / TITLE_RULES_BUCKET_SIZE;
+    memset(bucketStarts, 0, newBucketCount * sizeof(u16));
+    for (size_t i = 0; i < unique; i++)
+        bucketStarts[Hash(ruleTitleIds[sorted[i]], 0) % newBucketCount]++;
+    for (size_t b = 1; b < newBucketCount; b++)
+        bucketStarts[b] += bucketStarts[b - 1];
+    bucketStarts[newBucketCount] = (u16)unique;
+    for (size_t i = 0; i < unique; i++)
+        grouped[--bucketStarts[Hash(ruleTitleIds[sorted[i]], 0) % newBucketCount]] = sorted[i];
+
+    // Place the biggest buckets first, while most slots are still free
+    for (size_t b = 0; b < newBucketCount; b++)
+        order[b] = (u16)b;
+    std::sort(order, order + newBucketCount, [bucketStarts](u16 a, u16 b) {
+        u16 sizeA = bucketStarts[a + 1] - bucketStarts[a];
+        u16 sizeB = bucketStarts[b + 1] - bucketStarts[b];
+        return sizeA != sizeB ? sizeA > sizeB : a < b;
+    });
+
+    // The table itself, the title IDs first to keep them aligned
+    table = malloc(unique * sizeof(u64) + BitWords(unique) * sizeof(u32) + newBucketCount * sizeof(s32));
+    if (!table)
+    {
+        LOG("Not enough memory to build the title rules table for %d rules", (int)unique);
+        free(taken);
+        return false;
+    }
+    titleIds = static_cast<u64*>(table);
+    darkBits = reinterpret_cast<u32*>(titleIds + unique);
+    displacements = reinterpret_cast<s32*>(darkBits + BitWords(unique));
+    memset(taken, 0, BitWords(unique) * sizeof(u32));
+    memset(darkBits, 0, BitWords(unique) * sizeof(u32));
+    memset(displacements, 0, newBucketCount * sizeof(s32));
+
+    size_t positions[TITLE_RULES_MAX_BUCKET];
+    size_t nextFree = 0;
+    bool built = true;
+    for (size_t o = 0; o < newBucketCount && built; o++)
+    {
+        const u16* bucket = grouped + bucketStarts[order[o]];
+        size_t bucketSize = bucketStarts[order[o] + 1] - bucketStarts[order[o]];
+        if (bucketSize == 0)
+            break;
+
+        // Single-key buckets just take the next free slot directly
+        if (bucketSize == 1)
+        {
+            while (GetBit(taken, nextFree))
+                nextFree++;
+            SetBit(taken, nextFree, true);
+            titleIds[nextFree] = ruleTitleIds[bucket[0]];
+            SetBit(darkBits, nextFree, GetBit(ruleDarkBits, bucket[0]));
+            displacements[order[o]] = -(s32)nextFree - 1;
+            continue;
+        }
+
+        // Otherwise search for a seed mapping every key of the bucket to a distinct free slot
+        u32 seed = TITLE_RULES_MAX_SEED;
+        if (bucketSize <= TITLE_RULES_MAX_BUCKET)
+        {
+            for (seed = 1; seed < TITLE_RULES_MAX_SEED; seed++)
+            {
+                size_t k;
+                for (k = 0; k < bucketSize; k++)
+                {
+                    positions[k] = Hash(ruleTitleIds[bucket[k]], seed) % unique;
+                    if (GetBit(taken, positions[k]) || std::find(positions, positions + k, positions[k]) != positions + k)
+                        break;
+                }
+                if (k == bucketSize)
+                    break;
+            }
+        }
+
+        if (seed == TITLE_RULES_MAX_SEED)
+        {
+            LOG("Could not build the title rules table for %d rules", (int)unique);
+            built = false;
+            break;
+        }
+
+        for (size_t k = 0; k < bucketSize; k++)
+        {
+            SetBit(taken, positions[k], true);
+            titleIds[positions[k]] = ruleTitleIds[bucket[k]];
+            SetBit(darkBits, positions[k], GetBit(ruleDarkBits, bucket[k]));
+        }
+        displacements[order[o]] = (s32)seed;
+    }
+    free(taken);
+
+    if (!built)
+    {
+        Clear();
+        return false;
+    }
+    count = unique;
+    bucketCount = newBucketCount;
+    return true;
+}
+
+bool TitleRules::Find(u64 titleId, ColorSetId* theme) const
+{
+    if (count == 0)
+        return false;
+
+    // Empty buckets keep seed 0, which points at some slot that then fails the compare
+    s32 displacement = displacements[Hash(titleId, 0) % bucketCount];
+    size_t position = displacement < 0 ? (size_t)(-displacement - 1) : Hash(titleId, (u32)displacement) % count;
+    if (titleIds[position] != titleId)
+        return false;
+
+    *theme = GetBit(darkBits, position) ? ColorSetId_Dark : ColorSetId_Light;
+    return true;
+}
+
+void TitleRules::Clear()
+{
+    free(table);
+    table = NULL;
+    count = 0;
+    bucketCount = 0;
+    titleIds = NULL;
+    darkBits = NULL;
+    displacements = NULL;
+}
+
+u64 TitleRules::Hash(u64 key, u32 seed)
+{
+    // splitmix64 finalizer over the seeded key
+    u64 x = key ^ ((u64)seed * 0x9E3779B97F4A7C15ull);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
@@ -0,0 +1,83 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <vector>
+#include <switch.h>
+
+// Path of the per-title rules file
+#define TITLE_RULES_PATH "sdmc:/config/NXLightSwitch/TitleRules.ini"
+
+// Most rules the rules file may list. A longer file isn't loaded and the rules
+// loaded before stay, so the table can't grow past what the heap has room for.
+#define TITLE_RULES_MAX_COUNT 4096
+
+namespace nxlightswitch
+{
+    // A rule forcing a theme while a given title is running
+    struct TitleRule
+    {
+        u64 titleId;
+        ColorSetId theme;
+    };
+
+    // Holds the per-title theme rules. The rules are compiled into a minimal
+    // perfect hash when loaded, so finding the rule for a title is O(1) and
+    // doesn't allocate, no matter how many titles the rules file lists. The
+    // table is one block of about 9 bytes per rule, taken with malloc so that
+    // running out of heap fails the load rather than the module.
+    class TitleRules
+    {
+    public:
+        TitleRules();
+        ~TitleRules();
+
+        // Loads the rules from an INI file with a [TitleRules] section holding
+        // "<hex title ID> = light|dark" lines. The file is read twice through a
+        // line buffer, once to count the rules and once to take them in. Returns
+        // false if the file couldn't be read or lists more than
+        // TITLE_RULES_MAX_COUNT rules, which keeps the rules loaded before.
+        bool Load(const char* path);
+
+        // Compiles the given rules into the lookup table, replacing any loaded rules.
+        // When a title ID is listed more than once, the last rule wins.
+        bool Build(const std::vector<TitleRule>& rules);
+
+        // Finds the rule for the given title, returns false if there is none
+        bool Find(u64 titleId, ColorSetId* theme) const;
+
+        // Returns how many rules are loaded
+        size_t Count() const { return count; }
+
+    private:
+        TitleRules(const TitleRules&) = delete;
+        TitleRules& operator=(const TitleRules&) = delete;
+
+        // Compiles the rules in `ruleTitleIds`, with the theme of rule i in bit i of
+        // `ruleDarkBits`, into a new table. Frees the loaded table first, so the heap
+        // only ever holds one of them.
+        bool BuildTable(const u64* ruleTitleIds, const u32* ruleDarkBits, size_t ruleCount);
+
+        // Frees the table
+        void Clear();
+
+        // Seeded 64-bit mix used for both hash levels
+        static u64 Hash(u64 key, u32 seed);
+
+        // The one allocation holding the three arrays below
+        void* table;
+        size_t count;
+        size_t bucketCount;
+
+        // One title ID per slot, indexed by the second-level hash
+        u64* titleIds;
+
+        // Bit per slot, set if the rule in it forces dark
+        u32* darkBits;
+
+        // Per-bucket displacement seed, or -(slot + 1) for single-key buckets
+        s32* displacements;
+    };
+}
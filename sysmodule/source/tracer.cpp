@@ -0,0 +1,108 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include "tracer.hpp"
+#include <cstdio>
+#include <cstring>
+using namespace nxlightswitch;
+
+// Needed for compiler
+Tracer Tracer::singleton;
+bool Tracer::enabled = false;
+
+Tracer* Tracer::get()
+{
+    return &singleton;
+}
+
+void Tracer::setEnabled(bool enable)
+{
+    enabled = enable;
+}
+
+void Tracer::begin(const char* name)
+{
+    record(name, 'B');
+}
+
+void Tracer::end(const char* name)
+{
+    record(name, 'E');
+}
+
+void Tracer::record(const char* name, char phase)
+{
+    // Mark the slot as being written while filling it in, see dump()
+    u32 index = nextEvent.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots[index % TRACE_BUFFER_SIZE];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.event.name = name;
+    slot.event.tick = armGetSystemTick();
+    slot.event.threadId = (u32)threadGetCurHandle();
+    slot.event.phase = phase;
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+bool Tracer::dump()
+{
+    FILE* traceFile = fopen(TRACE_FILE_PATH, "w");
+    if (!traceFile)
+        return false;
+
+    // Spans each thread has open so far, so ends whose begin was overwritten are left out
+    u32 threadIds[TRACE_MAX_THREADS];
+    u32 openSpans[TRACE_MAX_THREADS];
+    u32 threadCount = 0;
+
+    u32 endEvent = nextEvent.load(std::memory_order_acquire);
+    u32 count = endEvent - dumpedEvents < TRACE_BUFFER_SIZE ? endEvent - dumpedEvents : TRACE_BUFFER_SIZE;
+    u32 written = 0;
+
+    // Timestamps are in microseconds since the system tick started counting
+    fprintf(traceFile, "{\"traceEvents\":[\n");
+    for (u32 i = endEvent - count; i != endEvent; i++)
+    {
+        // Work on a copy, and skip events another thread overwrote or is still writing
+        const Slot& slot = slots[i % TRACE_BUFFER_SIZE];
+        u32 sequence = slot.sequence.load(std::memory_order_acquire);
+        Event event;
+        memcpy(&event, &slot.event, sizeof(event));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence != i + 1 || slot.sequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+
+        u32 thread = 0;
+        while (thread < threadCount && threadIds[thread] != event.threadId)
+            thread++;
+        if (thread == threadCount && thread < TRACE_MAX_THREADS)
+        {
+            threadIds[threadCount] = event.threadId;
+            openSpans[threadCount++] = 0;
+        }
+        if (thread < threadCount)
+        {
+            if (event.phase == 'E' && openSpans[thread] == 0)
+                continue;
+            openSpans[thread] += event.phase == 'B' ? 1 : -1;
+        }
+
+        fprintf(traceFile, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":1,\"tid\":%u}\n",
+            written++ > 0 ? "," : "",
+            event.name,
+            event.phase,
+            (unsigned long long)(armTicksToNs(event.tick) / 1000),
+            event.threadId);
+    }
+    // Counts the events overwritten since the last dump, and the ends left out
+    fprintf(traceFile, "],\"otherData\":{\"droppedEvents\":%u}}\n", endEvent - dumpedEvents - written);
+
+    fflush(traceFile);
+    fclose(traceFile);
+
+    dumpedEvents = endEvent;
+    return true;
+}
@@ -0,0 +1,102 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <switch.h>
+#include <atomic>
+
+// Path the trace gets written to, in Chrome's trace event format
+#define TRACE_FILE_PATH "sdmc:/NXLightSwitch.trace.json"
+
+// Number of begin/end events the trace buffer holds, older ones get overwritten
+#define TRACE_BUFFER_SIZE 1024
+
+// Number of threads whose spans a dump keeps track of, to leave out the ends of
+// spans whose begin got overwritten
+#define TRACE_MAX_THREADS 8
+
+// Records a span covering the rest of the enclosing scope
+#define TRACE_SCOPE_NAME2(line) traceScope##line
+#define TRACE_SCOPE_NAME(line) TRACE_SCOPE_NAME2(line)
+#define TRACE_SCOPE(name) nxlightswitch::TraceScope TRACE_SCOPE_NAME(__LINE__)(name)
+
+namespace nxlightswitch
+{
+    // Records begin/end spans into a fixed, preallocated ring and writes them out
+    // as a Chrome/Perfetto trace (load it in chrome://tracing or ui.perfetto.dev).
+    // The ring keeps the last TRACE_BUFFER_SIZE events, so a dump shows what
+    // happened most recently.
+    class Tracer
+    {
+    public:
+        // Returns the singleton instance of this tracer
+        static Tracer* get();
+
+        // Whether spans are recorded. This is the only thing a span checks while
+        // tracing is disabled.
+        static bool enabled;
+
+        // Turns tracing on or off
+        void setEnabled(bool enable);
+
+        // Records the begin/end of a span. Names must be string literals.
+        void begin(const char* name);
+        void end(const char* name);
+
+        // Writes the events recorded since the last dump to TRACE_FILE_PATH, oldest
+        // first, along with how many of them were dropped
+        bool dump();
+
+    private:
+        struct Event
+        {
+            const char* name;
+            u64 tick;
+            u32 threadId;
+            char phase;
+        };
+
+        // Any thread can record, so every slot holds the index of its event plus one
+        // once it's complete, and 0 while it's being written
+        struct Slot
+        {
+            std::atomic<u32> sequence;
+            Event event;
+        };
+
+        void record(const char* name, char phase);
+
+        Slot slots[TRACE_BUFFER_SIZE];
+        std::atomic<u32> nextEvent;
+
+        // Index of the first event the next dump writes
+        u32 dumpedEvents;
+
+        // Singleton instance
+        static Tracer singleton;
+    };
+
+    // Begins a span on construction and ends it on destruction
+    class TraceScope
+    {
+    public:
+        TraceScope(const char* name)
+            : name(name), active(__builtin_expect(Tracer::enabled, 0))
+        {
+            if (active)
+                Tracer::get()->begin(name);
+        }
+
+        ~TraceScope()
+        {
+            if (active)
+                Tracer::get()->end(name);
+        }
+
+    private:
+        const char* name;
+        bool active;
+    };
+}
@@ -3,8 +3,38 @@
     Made with love by Jonathan Verbeek (jverbeek.de)
 */
 
+#pragma once
+#include <cstdio>
+#include <cstring>
 #include <switch.h>
 #include "logger.hpp"
 
 // Logs if the given result is not successful
 #define LOG_IF_ERROR(r) if (R_FAILED(r)) { Logger::get()->logError(r); }
+
+// FNV-1a over some bytes, continuing from the given hash
+#define HASH_BYTES_BASIS 2166136261u
+static inline u32 HashBytes(const void* data, size_t size, u32 hash = HASH_BYTES_BASIS)
+{
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ static_cast<const u8*>(data)[i]) * 16777619u;
+    return hash;
+}
+
+// Reads a line like fgets, for ini_parse_stream, but drops the rest of lines too
+// long for the buffer, so the end of a long comment isn't taken for a line of its own
+static inline char* ReadIniLine(char* str, int num, void* stream)
+{
+    FILE* file = static_cast<FILE*>(stream);
+    if (!fgets(str, num, file))
+        return NULL;
+
+    size_t length = strlen(str);
+    if (length > 0 && str[length - 1] != '\n')
+    {
+        int c;
+        while ((c = fgetc(file)) != EOF && c != '\n')
+            ;
+    }
+    return str;
+}
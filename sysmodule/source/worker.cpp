@@ -4,125 +4,652 @@
 */
 
 #include "worker.hpp"
+#include "clock.hpp"
 #include "logger.hpp"
+#include "tracer.hpp"
+#include "utils.hpp"
+#ifdef NXLS_BAKED_CONFIG
+#include "baked_config.h"
+#else
 #include "ini/inireader.hpp"
-#include <iomanip>
-#include <sstream>
+#endif
+#include <algorithm>
 #include <switch.h>
 using namespace nxlightswitch;
 
+#ifndef NXLS_BAKED_CONFIG
+// Config keys, hashed at compile time
+static constexpr INIKey LightTimeKey("NXLightSwitch", "LightTime");
+static constexpr INIKey DarkTimeKey("NXLightSwitch", "DarkTime");
+static constexpr INIKey LightBrightnessKey("NXLightSwitch", "LightBrightness");
+static constexpr INIKey DarkBrightnessKey("NXLightSwitch", "DarkBrightness");
+static constexpr INIKey ReloadTimeKey("NXLightSwitch", "ReloadTime");
+static constexpr INIKey TraceKey("NXLightSwitch", "Trace");
+static constexpr INIKey RecordInputsKey("NXLightSwitch", "RecordInputs");
+static constexpr INIKey ClockResyncIntervalKey("NXLightSwitch", "ClockResyncInterval");
+static constexpr INIKey AmbientLightKey("NXLightSwitch", "AmbientLight");
+static constexpr INIKey AmbientLightThresholdKey("NXLightSwitch", "AmbientLightThreshold");
+static constexpr INIKey AmbientLightHysteresisKey("NXLightSwitch", "AmbientLightHysteresis");
+#endif
+
+#ifndef NXLS_BAKED_CONFIG
+// Parses a time in the HH:MM format, the hour and minute may have one or two digits
+static bool ParseTime(const char* str, struct std::tm* time)
+{
+    *time = {};
+
+    // Like std::get_time, a valid hour is kept even if the minute isn't
+    int* fields[] = { &time->tm_hour, &time->tm_min };
+    const int limits[] = { 23, 59 };
+    for (int i = 0; i < 2; i++)
+    {
+        if (i == 1 && *str++ != ':')
+            return false;
+        if (*str < '0' || *str > '9')
+            return false;
+
+        int value = *str++ - '0';
+        if (*str >= '0' && *str <= '9')
+            value = value * 10 + (*str++ - '0');
+        if (value > limits[i])
+            return false;
+
+        *fields[i] = value;
+    }
+
+    return true;
+}
+#endif
+
+// Returns the last time the given minute of the day passed, at or before nowMinute
+static u64 LastOccurrence(u64 nowMinute, u32 minuteOfDay)
+{
+    u64 minute = nowMinute - nowMinute % MINUTES_PER_DAY + minuteOfDay;
+    return minute > nowMinute ? minute - MINUTES_PER_DAY : minute;
+}
+
+// Compares the hour and minute of two times
+static bool IsSameTime(const struct std::tm& a, const struct std::tm& b)
+{
+    return a.tm_hour == b.tm_hour && a.tm_min == b.tm_min;
+}
+
+Worker::Worker(Platform* platform, ForegroundTitleSource* titleSource)
+    : platform(platform), configRead(false), configSize(0), configHash(0), lightBrightness(-1.0f), darkBrightness(-1.0f), ambientLightEnabled(false),
+      ambientLightThreshold(AMBIENT_LIGHT_DEFAULT_THRESHOLD), ambientLightHysteresis(AMBIENT_LIGHT_DEFAULT_HYSTERESIS), hasReloadTime(false), recordInputs(false), scheduleDirty(true),
+      configFingerprint(0), stateRestoreTried(false), hasAppliedTheme(false), appliedTheme(ColorSetId_Light),
+      themeOverridden(false), currentTime(0), currentMinute(0), scheduledTheme(ColorSetId_Light), themeDirty(false),
+      titleSource(titleSource), exceptionAction(-1), nextAmbientLightReading(0), timeBreaker("timeGetCurrentTime", platform),
+      getColorSetBreaker("setsysGetColorSetId", platform), setColorSetBreaker("setsysSetColorSetId", platform),
+      ambientLightBreaker("lblGetAmbientLightSensorValue", platform)
+{
+    lightTime = {};
+    darkTime = {};
+    reloadTime = {};
+    currentCalendarTime = {};
+
+    // Read the config right away, so a recording of the inputs can start with the module
+    ReadConfig();
+
+#ifndef NXLS_BAKED_CONFIG
+    // The title rules are optional, so a missing file is fine
+    if (titleRules.Load(TITLE_RULES_PATH))
+    {
+        LOG("Loaded %d title rules", (int)titleRules.Count());
+    }
+#endif
+}
+
+u64 Worker::GetWaitTimeout(u64 timeout)
+{
+    // Don't sleep past the next scheduled action
+    u64 nextMinute;
+    if (!scheduleDirty && scheduler.GetNextExpiry(&nextMinute) && nextMinute > currentMinute)
+    {
+        u64 untilNext = ((nextMinute - currentMinute) * 60 - currentCalendarTime.second) * 1000000000ull;
+        if (untilNext < timeout)
+            timeout = untilNext;
+    }
+
+    // Nor past the next ambient light reading
+    if (ambientLightEnabled && nextAmbientLightReading > currentTime)
+    {
+        u64 untilReading = (nextAmbientLightReading - currentTime) * 1000000000ull;
+        if (untilReading < timeout)
+            timeout = untilReading;
+    }
+
+    return timeout;
+}
+
 void Worker::DoWork()
 {
+    TRACE_SCOPE("Worker::DoWork");
+
+    // 0. Look for a new foreground application, which may have a rule of its own
+    if (titleSource->Refresh())
+        themeDirty = true;
+
     // 1. Read the config if it changed to see if we got any new times
     if (!ReadConfig())
         return;
 
-    // 2. Compare the times from the config with the current time to see if we should
-    //    update the systems theme
+    // 2. Run the scheduled actions which became due since the last tick
+    if (!UpdateSchedule())
+        return;
+
+    // 3. Read the ambient light if it picks the theme and a reading is due
+    UpdateAmbientLight();
+
+    // 4. Apply the theme if the schedule, the ambient light or the running title asks for another one
     CheckForThemeChange();
 }
 
 bool Worker::ReadConfig()
 {
-    // Create a new INIReader to read the config file
-    INIReader iniReader("sdmc:/config/NXLightSwitch/NXLightSwitch.ini");
+    TRACE_SCOPE("Worker::ReadConfig");
+
+    struct std::tm newLightTime, newDarkTime, newReloadTime;
+    bool newHasReloadTime;
+    float newLightBrightness, newDarkBrightness;
+    bool newAmbientLightEnabled;
+    float newAmbientLightThreshold, newAmbientLightHysteresis;
+    bool trace;
+
+#ifdef NXLS_BAKED_CONFIG
+    // The schedule was compiled in, so there's nothing to read after the first time
+    if (configRead)
+        return true;
+
+    newLightTime = {};
+    newLightTime.tm_hour = BakedConfigValues.lightHour;
+    newLightTime.tm_min = BakedConfigValues.lightMinute;
+    newDarkTime = {};
+    newDarkTime.tm_hour = BakedConfigValues.darkHour;
+    newDarkTime.tm_min = BakedConfigValues.darkMinute;
+    // Reloading only picks up files from the SD card, which isn't mounted
+    newReloadTime = {};
+    newHasReloadTime = false;
+    newLightBrightness = BakedConfigValues.lightBrightness;
+    newDarkBrightness = BakedConfigValues.darkBrightness;
+    newAmbientLightEnabled = BakedConfigValues.ambientLight;
+    newAmbientLightThreshold = BakedConfigValues.ambientLightThreshold;
+    newAmbientLightHysteresis = BakedConfigValues.ambientLightHysteresis;
+    trace = false;
+    recordInputs = false;
+#else
+    // Read the config file through the platform, so a recording has it too
+    size_t newConfigSize = 0;
+    if (!platform->ReadFile(CONFIG_PATH, configBuffer, sizeof(configBuffer), &newConfigSize))
+    {
+        if (newConfigSize == sizeof(configBuffer))
+            LOG("Config file is larger than %d bytes, shorten it!", CONFIG_MAX_SIZE);
+        else
+            LOG("Error reading config file!");
+        return false;
+    }
+
+    // The config rarely changes, so don't parse it again (which allocates) unless it did
+    u32 newConfigHash = HashBytes(configBuffer, newConfigSize);
+    if (configRead && newConfigSize == configSize && newConfigHash == configHash)
+        return true;
 
-    // Make sure we were able to read the ini file
+    // Create a new INIReader to parse the config file
+    INIReader iniReader(configBuffer, newConfigSize);
+
+    // Make sure we were able to parse the ini file
     if (iniReader.ParseError() < 0)
     {
-        Logger::get()->log("Error loading config file! Error code: %d", iniReader.ParseError());
+        LOG("Error loading config file! Error code: %d", iniReader.ParseError());
         return false;
     }
 
     // Read the values off the config
-    std::string lightTimeStr = iniReader.GetString("NXLightSwitch", "LightTime", "0");
-    std::string darkTimeStr = iniReader.GetString("NXLightSwitch", "DarkTime", "0");
+    ParseTime(iniReader.GetString(LightTimeKey, "0"), &newLightTime);
+    ParseTime(iniReader.GetString(DarkTimeKey, "0"), &newDarkTime);
+    newHasReloadTime = ParseTime(iniReader.GetString(ReloadTimeKey, ""), &newReloadTime);
+    newLightBrightness = (float)iniReader.GetReal(LightBrightnessKey, -1.0);
+    newDarkBrightness = (float)iniReader.GetReal(DarkBrightnessKey, -1.0);
+
+    // The ambient light mode is off unless asked for
+    newAmbientLightEnabled = iniReader.GetBoolean(AmbientLightKey, false);
+    newAmbientLightThreshold = (float)iniReader.GetReal(AmbientLightThresholdKey, AMBIENT_LIGHT_DEFAULT_THRESHOLD);
+    newAmbientLightHysteresis = (float)iniReader.GetReal(AmbientLightHysteresisKey, AMBIENT_LIGHT_DEFAULT_HYSTERESIS);
+
+    // Tracing is off unless asked for
+    trace = iniReader.GetBoolean(TraceKey, false);
 
-    // Convert the string times into time_t times
-    // Note: the times need to be in the following format: HH:MM (see http://www.cplusplus.com/reference/ctime/strftime/)
-    lightTime = {0};
-    std::istringstream ssLight(lightTimeStr);
-    ssLight >> std::get_time(&lightTime, "%R");
+    // Same for recording the inputs
+    recordInputs = iniReader.GetBoolean(RecordInputsKey, false);
 
-    darkTime = {0};
-    std::istringstream ssDark(darkTimeStr);
-    ssDark >> std::get_time(&darkTime, "%R");
+    // How often the clock asks the time service for the time (in seconds)
+    Clock::get()->setResyncInterval((u64)std::max(iniReader.GetInteger(ClockResyncIntervalKey, CLOCK_DEFAULT_RESYNC_INTERVAL), 0L));
 
-    //Logger::get()->log("Light: %d:%d - Dark: %d:%d", lightTime.tm_hour, lightTime.tm_min, darkTime.tm_hour, darkTime.tm_min);
+    configSize = newConfigSize;
+    configHash = newConfigHash;
+#endif
+
+    configRead = true;
+
+    // Only rebuild the schedule when something in it changed
+    if (!IsSameTime(newLightTime, lightTime) || !IsSameTime(newDarkTime, darkTime)
+        || newHasReloadTime != hasReloadTime || (hasReloadTime && !IsSameTime(newReloadTime, reloadTime))
+        || newLightBrightness != lightBrightness || newDarkBrightness != darkBrightness)
+    {
+        lightTime = newLightTime;
+        darkTime = newDarkTime;
+        hasReloadTime = newHasReloadTime;
+        reloadTime = newReloadTime;
+        lightBrightness = newLightBrightness;
+        darkBrightness = newDarkBrightness;
+        scheduleDirty = true;
+
+        // Tells the journal which config its state belongs to
+        s32 values[] = {
+            lightTime.tm_hour, lightTime.tm_min, darkTime.tm_hour, darkTime.tm_min,
+            hasReloadTime ? reloadTime.tm_hour * 60 + reloadTime.tm_min : -1,
+            (s32)(lightBrightness * 1000.0f), (s32)(darkBrightness * 1000.0f)
+        };
+        configFingerprint = HashBytes(values, sizeof(values));
+    }
+
+    // Start over with the readings whenever the ambient light mode changed
+    if (newAmbientLightEnabled != ambientLightEnabled || newAmbientLightThreshold != ambientLightThreshold
+        || newAmbientLightHysteresis != ambientLightHysteresis)
+    {
+        ambientLightEnabled = newAmbientLightEnabled;
+        ambientLightThreshold = newAmbientLightThreshold;
+        ambientLightHysteresis = newAmbientLightHysteresis;
+        ambientLight.Configure(ambientLightThreshold, ambientLightHysteresis);
+        nextAmbientLightReading = 0;
+        themeDirty = true;
+    }
+
+    Tracer::get()->setEnabled(trace);
+    platform->SetRecording(recordInputs);
 
     return true;
 }
 
-void Worker::CheckForThemeChange()
+bool Worker::UpdateSchedule()
 {
+    TRACE_SCOPE("Worker::UpdateSchedule");
+
+    // Don't even ask while the time service keeps failing
+    if (!timeBreaker.ShouldAttempt())
+        return false;
+
     // Get the current time of the Nintendo Switch console using libnx
     u64 currentConsoleTime;
-    Result getTimeResult = timeGetCurrentTime(TimeType::TimeType_UserSystemClock, &currentConsoleTime);
+    Result getTimeResult;
+    {
+        TRACE_SCOPE("timeGetCurrentTime");
+        getTimeResult = platform->GetCurrentTime(&currentConsoleTime, &currentCalendarTime);
+    }
 
     // Make sure we were able to get the time
+    timeBreaker.OnResult(getTimeResult);
     if (R_FAILED(getTimeResult))
+        return false;
+
+    currentTime = currentConsoleTime;
+    currentMinute = Scheduler::MinuteFromCalendar(currentCalendarTime.year, currentCalendarTime.month,
+        currentCalendarTime.day, currentCalendarTime.hour, currentCalendarTime.minute);
+
+    // The exceptions are expanded for this year and the next, so expand them again every year
+    if (currentCalendarTime.year != exceptionCalendar.GetYear())
+    {
+#ifdef NXLS_BAKED_CONFIG
+        // There's no exceptions file without the SD card
+        exceptionCalendar.Build(std::vector<ExceptionRule>(), currentCalendarTime.year);
+#else
+        if (exceptionCalendar.Load(EXCEPTIONS_PATH, currentCalendarTime.year))
+        {
+            LOG("Loaded %d exception intervals", (int)exceptionCalendar.Count());
+        }
+        else
+        {
+            // Nothing to load, but don't try again until next year
+            exceptionCalendar.Build(std::vector<ExceptionRule>(), currentCalendarTime.year);
+        }
+#endif
+        scheduleDirty = true;
+    }
+
+    // A clock going backwards means the user changed the time, so start over
+    if (scheduleDirty || currentMinute < scheduler.GetCurrentMinute())
+    {
+        BuildSchedule(currentMinute);
+    }
+    else
     {
-        Logger::get()->logError(getTimeResult);
+        scheduler.Advance(currentMinute);
+    }
+
+    return true;
+}
+
+void Worker::UpdateAmbientLight()
+{
+    if (!ambientLightEnabled)
+        return;
+
+    // Not due yet, unless the clock went back since the reading was planned
+    if (currentTime < nextAmbientLightReading && nextAmbientLightReading - currentTime <= AMBIENT_LIGHT_MAX_INTERVAL)
+        return;
+
+    // Consoles without a sensor fail every time, which the breaker backs off from
+    if (!ambientLightBreaker.ShouldAttempt())
         return;
+
+    float lux;
+    Result getAmbientLightResult;
+    {
+        TRACE_SCOPE("lblGetAmbientLightSensorValue");
+        getAmbientLightResult = platform->GetAmbientLight(&lux);
     }
 
-    // Make a TimeCalendarTime out of the timestamp using libnx' features
-    TimeCalendarTime consoleCalendarTime;
-    TimeCalendarAdditionalInfo consoleCalendarInfo;
-    timeToCalendarTimeWithMyRule(currentConsoleTime, &consoleCalendarTime, &consoleCalendarInfo);
+    ambientLightBreaker.OnResult(getAmbientLightResult);
+    if (R_FAILED(getAmbientLightResult))
+        return;
+
+    if (ambientLight.AddReading(lux))
+    {
+        themeDirty = true;
+    }
+    nextAmbientLightReading = currentTime + ambientLight.GetInterval();
 
-    // Now perform some logic checks to see if we should change the theme
-    bool needsLightThemeChange = consoleCalendarTime.hour >= lightTime.tm_hour 
-        && consoleCalendarTime.minute >= lightTime.tm_min
-        && ((consoleCalendarTime.hour > darkTime.tm_hour && (consoleCalendarTime.minute > darkTime.tm_min || consoleCalendarTime.minute == 0)) 
-            || (consoleCalendarTime.hour == darkTime.tm_hour && consoleCalendarTime.minute > darkTime.tm_min));
+    // Routine, so only keep it in memory for when something goes wrong
+    RECORD("Ambient light %d lux, average %d lux, next reading in %d s", (int)lux, (int)ambientLight.GetAverage(), (int)ambientLight.GetInterval());
+}
 
-    bool needsDarkThemeChange = consoleCalendarTime.hour >= darkTime.tm_hour
-        && consoleCalendarTime.minute >= darkTime.tm_min
-        && ((consoleCalendarTime.hour < lightTime.tm_hour && (consoleCalendarTime.minute < lightTime.tm_min || consoleCalendarTime.minute == 0)) 
-            || (consoleCalendarTime.hour == lightTime.tm_hour && consoleCalendarTime.minute < lightTime.tm_min));
+void Worker::BuildSchedule(u64 nowMinute)
+{
+    scheduler.Reset(nowMinute);
+    scheduleDirty = false;
 
-    bool needsThemeChange = needsLightThemeChange || needsDarkThemeChange;
+    u32 lightMinute = lightTime.tm_hour * 60 + lightTime.tm_min;
+    u32 darkMinute = darkTime.tm_hour * 60 + darkTime.tm_min;
+    ScheduleDaily(nowMinute, lightMinute, ThemeAction, ColorSetId_Light);
+    ScheduleDaily(nowMinute, darkMinute, ThemeAction, ColorSetId_Dark);
 
-    ColorSetId currentTheme;
-    Result sysGetColorSetIdResult = setsysGetColorSetId(&currentTheme);
-    if (R_SUCCEEDED(sysGetColorSetIdResult))
+    // Find out which of the two periods we're in, which may span midnight
+    u32 minuteOfDay = (u32)(nowMinute % MINUTES_PER_DAY);
+    bool isLightPeriod = lightMinute < darkMinute
+        ? minuteOfDay >= lightMinute && minuteOfDay < darkMinute
+        : minuteOfDay >= lightMinute || minuteOfDay < darkMinute;
+
+    scheduledTheme = isLightPeriod ? ColorSetId_Light : ColorSetId_Dark;
+
+    // After a restart, carry on from the journal rather than applying everything again.
+    // The journal lives on the SD card, so baked builds always start over. So do
+    // recordings, as the replay doesn't have the journal.
+#ifdef NXLS_BAKED_CONFIG
+    bool restored = false;
+#else
+    bool restored = !stateRestoreTried && !recordInputs && RestoreState(nowMinute, lightMinute, darkMinute);
+#endif
+    stateRestoreTried = true;
+    if (!restored)
+        themeDirty = true;
+
+    if (lightBrightness >= 0.0f)
     {
-        Logger::get()->log("Got color theme");
+        ScheduleDaily(nowMinute, lightMinute, BrightnessAction, (u32)(lightBrightness * 1000.0f));
+        if (isLightPeriod && !restored)
+            ApplyBrightness(lightBrightness);
     }
-    else
+
+    if (darkBrightness >= 0.0f)
+    {
+        ScheduleDaily(nowMinute, darkMinute, BrightnessAction, (u32)(darkBrightness * 1000.0f));
+        if (!isLightPeriod && !restored)
+            ApplyBrightness(darkBrightness);
+    }
+
+    if (hasReloadTime)
+    {
+        ScheduleDaily(nowMinute, reloadTime.tm_hour * 60 + reloadTime.tm_min, ReloadAction, 0);
+    }
+
+    ScheduleExceptionBoundary(nowMinute);
+}
+
+bool Worker::RestoreState(u64 nowMinute, u32 lightMinute, u32 darkMinute)
+{
+    StateRecord record;
+    if (!stateJournal.Load(&record))
+        return false;
+
+    // The record is only still valid if it was made with the same config and no
+    // light/dark time passed since
+    u64 lastTransition = std::max(LastOccurrence(nowMinute, lightMinute), LastOccurrence(nowMinute, darkMinute));
+    u64 lastExceptionBoundary;
+    if (exceptionCalendar.GetLastBoundary(nowMinute, &lastExceptionBoundary))
+        lastTransition = std::max(lastTransition, lastExceptionBoundary);
+    if (record.configFingerprint != configFingerprint || record.minute < lastTransition || record.minute > nowMinute)
+        return false;
+
+    hasAppliedTheme = true;
+    appliedTheme = (ColorSetId)record.theme;
+    themeOverridden = record.overridden != 0;
+
+    // A different theme than the one we applied means the user picked it by hand.
+    // If setsys can't tell right now, the theme stays dirty so the check notices it.
+    themeDirty = true;
+    if (getColorSetBreaker.ShouldAttempt())
+    {
+        ColorSetId currentTheme;
+        Result sysGetColorSetIdResult;
+        {
+            TRACE_SCOPE("setsysGetColorSetId");
+            sysGetColorSetIdResult = platform->GetColorSetId(&currentTheme);
+        }
+
+        getColorSetBreaker.OnResult(sysGetColorSetIdResult);
+        if (R_SUCCEEDED(sysGetColorSetIdResult))
+        {
+            themeDirty = false;
+            if (currentTheme != appliedTheme && !themeOverridden)
+            {
+                LOG("Theme was changed by hand to %s", currentTheme == ColorSetId_Light ? "Light" : "Dark");
+                RecordTheme(appliedTheme, true);
+            }
+        }
+    }
+
+    LOG("Restored state: Theme = %s Overridden = %d", appliedTheme == ColorSetId_Light ? "Light" : "Dark", themeOverridden);
+    return true;
+}
+
+void Worker::RecordTheme(ColorSetId theme, bool overridden)
+{
+    hasAppliedTheme = true;
+    appliedTheme = theme;
+    themeOverridden = overridden;
+
+#ifndef NXLS_BAKED_CONFIG
+    if (!stateJournal.Write(theme, currentMinute, configFingerprint, overridden))
+    {
+        LOG("Could not write the state journal");
+    }
+#endif
+}
+
+void Worker::ScheduleDaily(u64 nowMinute, u32 minuteOfDay, ScheduledActionFunc func, u32 argument)
+{
+    // First run is today if that's still ahead, tomorrow otherwise
+    u64 firstMinute = nowMinute - nowMinute % MINUTES_PER_DAY + minuteOfDay;
+    if (firstMinute <= nowMinute)
+        firstMinute += MINUTES_PER_DAY;
+
+    scheduler.Schedule(firstMinute, MINUTES_PER_DAY, func, this, argument);
+}
+
+void Worker::ScheduleExceptionBoundary(u64 nowMinute)
+{
+    u64 boundary;
+    exceptionAction = exceptionCalendar.GetNextBoundary(nowMinute, &boundary)
+        ? scheduler.Schedule(boundary, 0, ExceptionAction, this, (u32)boundary) : -1;
+}
+
+void Worker::CheckForThemeChange()
+{
+    TRACE_SCOPE("Worker::CheckForThemeChange");
+
+    // Nothing to do until a scheduled action ran or the running title changed, so a
+    // theme the user picked by hand stays until the next light/dark time
+    if (!themeDirty)
+        return;
+
+    // A rule for the running title takes precedence over an exception for today,
+    // which takes precedence over the ambient light (if it is on), which takes
+    // precedence over the light/dark times
+    u64 titleId;
+    ColorSetId titleTheme;
+    bool hasTitleRule = titleSource->GetForegroundTitle(&titleId) && titleRules.Find(titleId, &titleTheme);
+    ColorSetId exceptionTheme;
+    bool hasException = exceptionCalendar.Find(currentMinute, &exceptionTheme);
+    bool useAmbientLight = ambientLightEnabled && ambientLight.HasTheme();
+    ColorSetId baseTheme = useAmbientLight ? ambientLight.GetTheme() : scheduledTheme;
+    ColorSetId newTheme = hasTitleRule ? titleTheme : hasException ? exceptionTheme : baseTheme;
+
+    // The theme stays dirty, so this is retried once setsys works again
+    if (!getColorSetBreaker.ShouldAttempt())
+        return;
+
+    ColorSetId currentTheme;
+    Result sysGetColorSetIdResult;
     {
-        Logger::get()->logError(sysGetColorSetIdResult);
+        TRACE_SCOPE("setsysGetColorSetId");
+        sysGetColorSetIdResult = platform->GetColorSetId(&currentTheme);
     }
 
-    Logger::get()->log("CheckForThemeChange() CurrentTime = %d:%d CurrentTheme = %s NeedsLightThemeChange = %d (%d:%d) NeedsDarkThemeChange = %d (%d:%d)",
-        consoleCalendarTime.hour,
-        consoleCalendarTime.minute,
+    // Try again next tick if we can't tell the current theme
+    getColorSetBreaker.OnResult(sysGetColorSetIdResult);
+    if (R_FAILED(sysGetColorSetIdResult))
+        return;
+
+    // Routine, so only keep it in memory for when something goes wrong
+    RECORD("CheckForThemeChange() CurrentTime = %d:%d CurrentTheme = %s NewTheme = %s (Light %d:%d Dark %d:%d TitleRule = %d Exception = %d AmbientLight = %d)",
+        currentCalendarTime.hour,
+        currentCalendarTime.minute,
         currentTheme == ColorSetId::ColorSetId_Light ? "Light" : "Dark",
-        needsLightThemeChange,
+        newTheme == ColorSetId::ColorSetId_Light ? "Light" : "Dark",
         lightTime.tm_hour,
         lightTime.tm_min,
-        needsDarkThemeChange,
         darkTime.tm_hour,
-        darkTime.tm_min);
+        darkTime.tm_min,
+        hasTitleRule,
+        hasException,
+        useAmbientLight);
+
+    themeDirty = false;
+
+    // Note it down if the user changed the theme we applied by hand
+    if (hasAppliedTheme && currentTheme != appliedTheme && !themeOverridden)
+    {
+        LOG("Theme was changed by hand to %s", currentTheme == ColorSetId_Light ? "Light" : "Dark");
+        RecordTheme(appliedTheme, true);
+    }
+
+    // Keep the user's pick until we'd apply another theme than the one they changed,
+    // e.g. at the next light/dark time
+    if (themeOverridden && currentTheme != newTheme && newTheme == appliedTheme)
+        return;
+
+    // Already there, just make sure the journal knows
+    if (currentTheme == newTheme && (!hasAppliedTheme || appliedTheme != newTheme || themeOverridden))
+    {
+        RecordTheme(newTheme, false);
+    }
 
     // Do we need to change the theme?
-    if (needsThemeChange)
+    if (currentTheme != newTheme)
     {
-        // What will the new theme be?
-        ColorSetId newTheme = needsLightThemeChange ? ColorSetId::ColorSetId_Light : ColorSetId::ColorSetId_Dark;
+        // Keep the theme dirty while setsys keeps failing
+        if (!setColorSetBreaker.ShouldAttempt())
+        {
+            themeDirty = true;
+            return;
+        }
 
-        // Apply the new theme using libnx
-        Result sysSetColorSetIdResult = setsysSetColorSetId(newTheme);
+        // Apply the new theme
+        Result sysSetColorSetIdResult;
+        {
+            TRACE_SCOPE("setsysSetColorSetId");
+            sysSetColorSetIdResult = platform->SetColorSetId(newTheme);
+        }
 
         // Check if it worked
+        setColorSetBreaker.OnResult(sysSetColorSetIdResult);
         if (R_SUCCEEDED(sysSetColorSetIdResult))
         {
-            Logger::get()->log("Changed theme to %s", newTheme == ColorSetId::ColorSetId_Light ? "Light" : "Dark");
+            LOG("Changed theme to %s", newTheme == ColorSetId::ColorSetId_Light ? "Light" : "Dark");
+            RecordTheme(newTheme, false);
         }
         else
         {
-            Logger::get()->logError(sysSetColorSetIdResult);
+            themeDirty = true;
         }
     }
 }
+
+void Worker::ApplyBrightness(float brightness)
+{
+    Result setBrightnessResult;
+    {
+        TRACE_SCOPE("lblSetCurrentBrightnessSetting");
+        setBrightnessResult = platform->SetBrightness(brightness);
+    }
+
+    if (R_SUCCEEDED(setBrightnessResult))
+    {
+        LOG("Changed brightness to %d%%", (int)(brightness * 100.0f));
+    }
+    else
+    {
+        Logger::get()->logError(setBrightnessResult);
+    }
+}
+
+void Worker::ThemeAction(void* context, u32 theme)
+{
+    Worker* worker = static_cast<Worker*>(context);
+    worker->scheduledTheme = (ColorSetId)theme;
+    worker->themeDirty = true;
+}
+
+void Worker::BrightnessAction(void* context, u32 permille)
+{
+    static_cast<Worker*>(context)->ApplyBrightness(permille / 1000.0f);
+}
+
+void Worker::ReloadAction(void* context, u32 argument)
+{
+    Worker* worker = static_cast<Worker*>(context);
+
+    // Never scheduled by baked builds, which don't mount the SD card
+#ifndef NXLS_BAKED_CONFIG
+    if (worker->titleRules.Load(TITLE_RULES_PATH))
+    {
+        LOG("Reloaded %d title rules", (int)worker->titleRules.Count());
+    }
+
+    // Reload the exceptions too, which moves their next boundary
+    if (worker->exceptionCalendar.Load(EXCEPTIONS_PATH, worker->exceptionCalendar.GetYear()))
+    {
+        LOG("Reloaded %d exception intervals", (int)worker->exceptionCalendar.Count());
+        worker->scheduler.Cancel(worker->exceptionAction);
+        worker->ScheduleExceptionBoundary(worker->scheduler.GetCurrentMinute());
+    }
+#endif
+    worker->themeDirty = true;
+}
+
+void Worker::ExceptionAction(void* context, u32 boundaryMinute)
+{
+    Worker* worker = static_cast<Worker*>(context);
+    worker->ScheduleExceptionBoundary(boundaryMinute);
+    worker->themeDirty = true;
+}
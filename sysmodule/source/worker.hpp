@@ -6,17 +6,39 @@
 #pragma once
 #include <cstdlib>
 #include <ctime>
+#include "ambientlight.hpp"
+#include "exceptioncalendar.hpp"
+#include "foreground.hpp"
+#include "platform.hpp"
+#include "scheduler.hpp"
+#include "servicebreaker.hpp"
+#include "statejournal.hpp"
+#include "titlerules.hpp"
 
 // This is the update interval for the worker thread (in nanoseconds)
 #define WORKER_UPDATE_INTERVAL 1e+10
 
+// Path of the config file, and the most of it we read. Longer files aren't read
+// at all, rather than cutting a setting in half.
+#define CONFIG_PATH "sdmc:/config/NXLightSwitch/NXLightSwitch.ini"
+#define CONFIG_MAX_SIZE 8192
+
 namespace nxlightswitch
 {
     // This class implements the logic for the NXLightSwitch sysmodule.
-    // It is ran by main.cpp in a dedicated thread.
+    // It is ran by main.cpp as a task on the executor.
     class Worker
     {
     public:
+        // Creates the worker, and reads the config and the per-title rules. The worker
+        // talks to the system through the given platform and reads the foreground
+        // application from the given source.
+        Worker(Platform* platform, ForegroundTitleSource* titleSource);
+
+        // Returns how long to wait until the next check, which is the given timeout
+        // unless a scheduled action is due earlier
+        u64 GetWaitTimeout(u64 timeout);
+
         // The main entry point for NXLightSwitch's logic. It will perform the rest.
         void DoWork();
 
@@ -24,13 +46,123 @@ namespace nxlightswitch
         // Reads the configuration file of NXLightSwitch and stores the values
         bool ReadConfig();
 
-        // Checks the console's current time and compares it with the stored light/dark time.
-        // Also changes the theme accordingly
+        // Gets the console's current time and runs the scheduled actions which became due.
+        // Rebuilds the schedule first if the config or the clock changed.
+        bool UpdateSchedule();
+
+        // Reads the ambient light sensor if the ambient light mode is on and a reading is due
+        void UpdateAmbientLight();
+
+        // Schedules the actions from the config and applies the state they imply right now
+        void BuildSchedule(u64 nowMinute);
+
+        // Picks up the state the journal recorded before the restart, if nothing
+        // happened since that would have changed it. Returns false otherwise.
+        bool RestoreState(u64 nowMinute, u32 lightMinute, u32 darkMinute);
+
+        // Remembers a theme being in effect, in memory and in the journal
+        void RecordTheme(ColorSetId theme, bool overridden);
+
+        // Schedules an action every day at the given minute of the day
+        void ScheduleDaily(u64 nowMinute, u32 minuteOfDay, ScheduledActionFunc func, u32 argument);
+
+        // Schedules an action at the next minute the exception in effect changes
+        void ScheduleExceptionBoundary(u64 nowMinute);
+
+        // Applies the scheduled theme (or the ambient light's), or the one of the running title's rule, if
+        // either of them changed since the last check
         void CheckForThemeChange();
 
+        // Sets the screen brightness (0 to 1)
+        void ApplyBrightness(float brightness);
+
+        // Scheduled actions. The context is the Worker.
+        static void ThemeAction(void* context, u32 theme);
+        static void BrightnessAction(void* context, u32 permille);
+        static void ReloadAction(void* context, u32 argument);
+        static void ExceptionAction(void* context, u32 boundaryMinute);
+
     private:
+        // Everything the worker takes in goes through here, so it can be recorded
+        Platform* platform;
+
+#ifndef NXLS_BAKED_CONFIG
+        // Contents of the config file
+        char configBuffer[CONFIG_MAX_SIZE];
+#endif
+
+        // Size and hash of the config contents parsed last, to skip parsing them again
+        bool configRead;
+        size_t configSize;
+        u32 configHash;
+
         // Data read from the config
         struct std::tm lightTime;
         struct std::tm darkTime;
+
+        // Screen brightness set along with the light/dark theme, negative if not set
+        float lightBrightness;
+        float darkBrightness;
+
+        // Whether the ambient light picks the theme instead of the light/dark times,
+        // and the brightness (in lux) and band it switches at
+        bool ambientLightEnabled;
+        float ambientLightThreshold;
+        float ambientLightHysteresis;
+
+        // Time of day the title rules get reloaded at, if set
+        bool hasReloadTime;
+        struct std::tm reloadTime;
+
+        // Whether the config asks for the inputs to be recorded
+        bool recordInputs;
+
+        // Runs all the timed actions
+        Scheduler scheduler;
+
+        // Whether the config changed since the schedule was built
+        bool scheduleDirty;
+
+        // Fingerprint of the config values the schedule is built from
+        u32 configFingerprint;
+
+        // Persists what we did across restarts
+        StateJournal stateJournal;
+        bool stateRestoreTried;
+
+        // Theme we applied last, and whether the user changed it by hand since
+        bool hasAppliedTheme;
+        ColorSetId appliedTheme;
+        bool themeOverridden;
+
+        // Console time of the last tick
+        u64 currentTime;
+        TimeCalendarTime currentCalendarTime;
+        u64 currentMinute;
+
+        // Theme the schedule asks for, and whether it (or the running title) changed
+        // since the theme was last checked
+        ColorSetId scheduledTheme;
+        bool themeDirty;
+
+        // Tells which application is running, for the per-title rules
+        ForegroundTitleSource* titleSource;
+
+        // Themes forced while specific titles are running
+        TitleRules titleRules;
+
+        // Themes forced on specific days, and the action running at the next change
+        ExceptionCalendar exceptionCalendar;
+        ScheduleHandle exceptionAction;
+
+        // Smoothed ambient light readings, and the console time the next one is due at
+        AmbientLightFilter ambientLight;
+        u64 nextAmbientLightReading;
+
+        // Back off from service calls which keep failing
+        ServiceBreaker timeBreaker;
+        ServiceBreaker getColorSetBreaker;
+        ServiceBreaker setColorSetBreaker;
+        ServiceBreaker ambientLightBreaker;
     };
 }
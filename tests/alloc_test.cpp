@@ -0,0 +1,111 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Runs the module's tasks through a warm-up, then through 100k worker ticks with
+// light/dark switches, games starting and stopping and a theme picked by hand,
+// and fails on any heap allocation made during them (see heaphooks.hpp for
+// which are counted).
+
+#include "test.hpp"
+#include "heaphooks.hpp"
+#include "tasks.hpp"
+using namespace nxlightswitch;
+
+#define WARM_UP_TICKS 20000
+#define MEASURED_TICKS 100000
+#define GAME_TITLE_ID 0x0100000000010000ULL
+
+// Counts the worker's ticks, starts counting allocations after the warm-up and
+// stops the executor after the measured ticks
+class CountingWorkerTask : public WorkerTask
+{
+public:
+    CountingWorkerTask(Worker* worker, Executor* executor) : WorkerTask(worker), executor(executor), ticks(0) {}
+
+    virtual bool Step(bool signalled)
+    {
+        if (ticks == WARM_UP_TICKS)
+            heaphooks::counting = true;
+        if (ticks == WARM_UP_TICKS + MEASURED_TICKS)
+        {
+            heaphooks::counting = false;
+            executor->Stop();
+        }
+        ticks++;
+        return WorkerTask::Step(signalled);
+    }
+
+    u32 GetTicks() const { return ticks; }
+
+private:
+    Executor* executor;
+    u32 ticks;
+};
+
+// Starts a game for an hour every five hours, and picks dark by hand every day at noon
+class ScenarioTask : public Task
+{
+public:
+    ScenarioTask() : hour(0) {}
+
+    virtual bool Step(bool signalled)
+    {
+        if (hour % 5 == 2)
+            stub::applicationTitleId = GAME_TITLE_ID;
+        else if (hour % 5 == 3)
+            stub::applicationTitleId = 0;
+        if (hour % 24 == 12)
+            stub::colorSet = ColorSetId_Dark;
+        hour++;
+        Sleep(3600000000000ULL);
+        return true;
+    }
+
+private:
+    u32 hour;
+};
+
+int main()
+{
+    // The hooks see allocations in both ways
+    heaphooks::counting = true;
+    int* volatile number = new int(1);
+    delete number;
+    void* volatile block = malloc(16);
+    free(block);
+    heaphooks::counting = false;
+    CHECK(heaphooks::allocations == 2);
+    heaphooks::allocations = 0;
+
+    FILE* file = fopen(CONFIG_PATH, "w");
+    fputs("[NXLightSwitch]\nLightTime = 07:00\nDarkTime = 19:00\nLightBrightness = 0.8\nDarkBrightness = 0.3\n", file);
+    fclose(file);
+    file = fopen(TITLE_RULES_PATH, "w");
+    fprintf(file, "[TitleRules]\n%016llX = dark\n", GAME_TITLE_ID);
+    fclose(file);
+
+    stub::reset();
+    SwitchPlatform platform;
+    PmForegroundTitleSource titleSource;
+    Worker worker(&platform, &titleSource);
+    Executor executor(&platform);
+    LogWriterTask logWriterTask;
+    CountingWorkerTask workerTask(&worker, &executor);
+    DumpRequestTask dumpRequestTask;
+    ScenarioTask scenario;
+    executor.Add(&logWriterTask);
+    executor.Add(&workerTask);
+    executor.Add(&dumpRequestTask);
+    executor.Add(&scenario);
+    executor.Run();
+
+    printf("%d worker ticks (%.1f days), %d allocations, %d theme changes\n", (int)MEASURED_TICKS,
+        armTicksToNs(stub::tick) / 86400e9, (int)heaphooks::allocations, (int)stub::setColorSetCalls);
+    CHECK(workerTask.GetTicks() == WARM_UP_TICKS + MEASURED_TICKS + 1);
+    CHECK(stub::setColorSetCalls > 20);
+    CHECK(heaphooks::allocations == 0);
+
+    return nxlightswitch_test::result();
+}
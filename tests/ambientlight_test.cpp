@@ -0,0 +1,174 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Records a day of the module picking the theme from the ambient light sensor,
+// for a few light profiles, and replays each recording through ReplayPlatform.
+// Reports how often the module woke up and read the sensor per hour and how
+// often the theme flipped, and checks the replay made the same decisions.
+
+#include "test.hpp"
+#include "inputtrace.hpp"
+#include "tasks.hpp"
+#include <cmath>
+using namespace nxlightswitch;
+
+#define HOUR 3600000000000ULL
+#define RUN_HOURS 24
+
+// Hour of the day at the given time since boot, which is at 06:00
+static double HourOfDay(u64 ns)
+{
+    return fmod(6.0 + ns / (double)HOUR, 24.0);
+}
+
+// Deterministic flicker of up to +-1 around 0
+static double Noise(u64 ns)
+{
+    double t = ns / 1e9;
+    return (sin(t * 0.37) + sin(t * 1.91 + 1.0) + sin(t * 7.3 + 2.0)) / 3.0;
+}
+
+// Sunlight through a window from 06:00 to 20:00, with a few lux at night
+static float Daylight(u64 ns)
+{
+    double sun = sin(M_PI * (HourOfDay(ns) - 6.0) / 14.0);
+    return (float)(3.0 + (sun > 0 ? 400.0 * sun : 0.0) + 2.0 * Noise(ns));
+}
+
+// A dim room which sits right at the threshold the whole day
+static float Hovering(u64 ns)
+{
+    return (float)(AMBIENT_LIGHT_DEFAULT_THRESHOLD + 3.0 * Noise(ns));
+}
+
+// A dark room where a lamp is turned on and off every half hour from 18:00 on
+static float Lamp(u64 ns)
+{
+    double hour = HourOfDay(ns);
+    bool on = hour >= 18.0 && fmod(hour * 2.0, 2.0) < 1.0;
+    return (float)((on ? 150.0 : 4.0) + Noise(ns));
+}
+
+// Daylight with a hand or a passing shadow over the sensor for 10 seconds every 15 minutes
+static float Shadows(u64 ns)
+{
+    bool shadow = ns % (15 * 60 * 1000000000ULL) < 10 * 1000000000ULL;
+    return shadow ? 1.0f : Daylight(ns);
+}
+
+// Stops the executor after the run
+class StopTask : public Task
+{
+public:
+    StopTask(Executor* executor) : executor(executor), started(false) {}
+
+    virtual bool Step(bool signalled)
+    {
+        if (started)
+        {
+            executor->Stop();
+            return false;
+        }
+        started = true;
+        Sleep(RUN_HOURS * HOUR);
+        return true;
+    }
+
+private:
+    Executor* executor;
+    bool started;
+};
+
+// Counts the wakeups, the sensor readings and the theme flips of a replay
+class CountingReplayPlatform : public ReplayPlatform
+{
+public:
+    CountingReplayPlatform() : wakeups(0), readings(0), flips(0) {}
+
+    virtual Result Wait(const Waiter* waiters, s32 count, u64 timeout, s32* index)
+    {
+        if (timeout > 0)
+            wakeups++;
+        return ReplayPlatform::Wait(waiters, count, timeout, index);
+    }
+
+    virtual Result GetAmbientLight(float* lux)
+    {
+        readings++;
+        return ReplayPlatform::GetAmbientLight(lux);
+    }
+
+    virtual Result SetColorSetId(ColorSetId theme)
+    {
+        flips++;
+        return ReplayPlatform::SetColorSetId(theme);
+    }
+
+    u32 wakeups;
+    u32 readings;
+    u32 flips;
+};
+
+// Records a day of the given profile, replays it and returns the theme flips
+static u32 Simulate(const char* name, float (*luxAt)(u64 ns))
+{
+    // Start in the dark, the first reading picks the theme
+    stub::reset();
+    stub::posixTimeBase += 6 * 3600;
+    stub::colorSet = ColorSetId_Dark;
+    stub::luxAt = luxAt;
+    u32 liveFlips;
+    {
+        SwitchPlatform switchPlatform;
+        PmForegroundTitleSource titleSource;
+        RecordingPlatform platform(&switchPlatform, &titleSource);
+        Worker worker(&platform, &platform);
+        Executor executor(&platform);
+        ModuleTasks tasks(&worker);
+        tasks.AddTo(&executor);
+        StopTask stopTask(&executor);
+        executor.Add(&stopTask);
+        executor.Run();
+        platform.SetRecording(false);
+        liveFlips = stub::setColorSetCalls;
+    }
+
+    CountingReplayPlatform platform;
+    if (!CHECK(platform.Load(INPUT_TRACE_PATH)))
+        return 0;
+    Worker worker(&platform, &platform);
+    Executor executor(&platform);
+    ModuleTasks tasks(&worker);
+    tasks.AddTo(&executor);
+    StopTask stopTask(&executor);
+    executor.Add(&stopTask);
+    platform.StopAtEnd(&executor);
+    executor.Run();
+
+    printf("%-9s %6.1f wakeups/h %6.1f readings/h %3d flips\n", name, platform.wakeups / (double)RUN_HOURS,
+        platform.readings / (double)RUN_HOURS, (int)platform.flips);
+    CHECK(platform.GetMismatchCount() == 0);
+    CHECK(platform.IsFinished());
+    CHECK(platform.flips == liveFlips);
+    return platform.flips;
+}
+
+int main()
+{
+    FILE* file = fopen(CONFIG_PATH, "w");
+    fputs("[NXLightSwitch]\nLightTime = 07:00\nDarkTime = 19:00\nAmbientLight = true\nRecordInputs = true\n", file);
+    fclose(file);
+
+    // Light once the sun is up and dark after sunset, whatever the shadows do
+    u32 daylightFlips = Simulate("Daylight", Daylight);
+    CHECK(daylightFlips == 2);
+    CHECK(Simulate("Hovering", Hovering) <= 1);
+    CHECK(Simulate("Shadows", Shadows) == daylightFlips);
+
+    // The lamp goes on 6 times and off 6 times, the first time on flips to light
+    CHECK(Simulate("Lamp", Lamp) == 12);
+
+    return nxlightswitch_test::result();
+}
@@ -0,0 +1,163 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Reads the Clock once per second against a virtual clock source whose time
+// runs apart from its ticks, and checks how far the extrapolated time gets off
+// and how often the time service would have been asked
+
+#include "test.hpp"
+#include "clock.hpp"
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+using namespace nxlightswitch;
+
+#define SECONDS_PER_HOUR 3600
+#define NS_PER_SECOND 1000000000ULL
+
+// A console whose clock runs drift (relative) faster than its tick, and which
+// the user can set to another time
+class VirtualClockSource : public ClockSource
+{
+public:
+    VirtualClockSource(double drift)
+        : drift(drift), tick(0), offset(1704067200.0), utcOffset(3600), timeCalls(0) {}
+
+    virtual u64 GetTick() { return tick; }
+
+    virtual Result GetTime(u64* posixTime, s32* utcOffset)
+    {
+        timeCalls++;
+        *posixTime = GetTrueTime();
+        *utcOffset = this->utcOffset;
+        return 0;
+    }
+
+    // The time the console's clock shows right now
+    u64 GetTrueTime() const { return (u64)floor(offset + armTicksToNs(tick) / 1e9 * (1.0 + drift)); }
+
+    void Advance(u64 seconds) { tick += armNsToTicks(seconds * NS_PER_SECOND); }
+    void SetClock(double seconds) { offset += seconds; }
+    u32 GetTimeCalls() const { return timeCalls; }
+
+private:
+    double drift;
+    u64 tick;
+    double offset;
+    s32 utcOffset;
+    u32 timeCalls;
+};
+
+// Reads the clock once per second for the given time, returns the largest error
+// in seconds, and checks the calendar time matches the POSIX time it came with
+static s64 Run(VirtualClockSource& source, u32 seconds)
+{
+    s64 maxError = 0;
+    for (u32 i = 0; i < seconds; i++)
+    {
+        source.Advance(1);
+        u64 posixTime;
+        TimeCalendarTime calendarTime;
+        if (!CHECK(R_SUCCEEDED(Clock::get()->getCurrentTime(&posixTime, &calendarTime))))
+            return -1;
+
+        s64 error = std::abs((s64)posixTime - (s64)source.GetTrueTime());
+        maxError = std::max(maxError, error);
+
+        time_t local = (time_t)posixTime + 3600;
+        struct tm expected;
+        gmtime_r(&local, &expected);
+        if (calendarTime.year != expected.tm_year + 1900 || calendarTime.month != expected.tm_mon + 1 || calendarTime.day != expected.tm_mday
+            || calendarTime.hour != expected.tm_hour || calendarTime.minute != expected.tm_min || calendarTime.second != expected.tm_sec)
+        {
+            CHECK(!"calendar time matches the POSIX time");
+            return -1;
+        }
+    }
+    return maxError;
+}
+
+// A slightly slow tick, as real hardware has, stays within a second of the
+// console's time while only asking every resync interval
+static void TestSmallDrift()
+{
+    VirtualClockSource source(50e-6);
+    Clock::get()->setResyncInterval(CLOCK_DEFAULT_RESYNC_INTERVAL);
+    Clock::get()->setSource(&source);
+
+    s64 maxError = Run(source, 24 * SECONDS_PER_HOUR);
+    printf("50 ppm drift: %d time service calls for %d readings, off by up to %d s\n",
+        (int)source.GetTimeCalls(), 24 * SECONDS_PER_HOUR, (int)maxError);
+    CHECK(maxError <= 1);
+    CHECK(source.GetTimeCalls() <= 24 * SECONDS_PER_HOUR / CLOCK_DEFAULT_RESYNC_INTERVAL + 1);
+}
+
+// A clock set by hand is picked up at the next sync, after which the clock
+// syncs sooner than usual once, and then at the resync interval again
+static void TestClockChanged()
+{
+    VirtualClockSource source(0.0);
+    Clock::get()->setSource(&source);
+    Run(source, SECONDS_PER_HOUR + CLOCK_DEFAULT_RESYNC_INTERVAL / 3);
+
+    source.SetClock(SECONDS_PER_HOUR);
+    u32 calls = source.GetTimeCalls();
+    CHECK(Run(source, CLOCK_DEFAULT_RESYNC_INTERVAL) == SECONDS_PER_HOUR);
+    CHECK(source.GetTimeCalls() - calls == 1);
+    CHECK(Run(source, 1) == 0);
+
+    // The sync which noticed it lies less than a resync interval back
+    calls = source.GetTimeCalls();
+    CHECK(Run(source, CLOCK_DEFAULT_RESYNC_INTERVAL * 2 / 3) == 0);
+    CHECK(source.GetTimeCalls() - calls == 1);
+
+    calls = source.GetTimeCalls();
+    CHECK(Run(source, SECONDS_PER_HOUR) == 0);
+    printf("Clock set forward: %d time service calls in the hour after\n", (int)(source.GetTimeCalls() - calls));
+    CHECK(source.GetTimeCalls() - calls <= SECONDS_PER_HOUR / CLOCK_DEFAULT_RESYNC_INTERVAL + 1);
+}
+
+// A tick far off the console's time makes the clock sync often enough to stay
+// close, but no more often than CLOCK_MIN_RESYNC_INTERVAL
+static void TestLargeDrift()
+{
+    VirtualClockSource source(0.02);
+    Clock::get()->setSource(&source);
+
+    s64 maxError = Run(source, SECONDS_PER_HOUR);
+    u32 calls = source.GetTimeCalls();
+    maxError = Run(source, SECONDS_PER_HOUR);
+    printf("2%% drift: %d time service calls per hour, off by up to %d s\n",
+        (int)(source.GetTimeCalls() - calls), (int)maxError);
+    CHECK(maxError <= CLOCK_MAX_DRIFT + 1);
+    CHECK(source.GetTimeCalls() - calls <= SECONDS_PER_HOUR / CLOCK_MIN_RESYNC_INTERVAL + 1);
+}
+
+// Events logged before the last sync get the second they happened in
+static void TestCalendarTimeAtTick()
+{
+    VirtualClockSource source(0.0);
+    Clock::get()->setSource(&source);
+    Run(source, 10);
+    u64 tick = source.GetTick();
+    u64 posixTime = source.GetTrueTime();
+    Run(source, 2 * CLOCK_DEFAULT_RESYNC_INTERVAL);
+
+    TimeCalendarTime calendarTime;
+    CHECK(R_SUCCEEDED(Clock::get()->getCalendarTimeAtTick(tick, &calendarTime)));
+    time_t local = (time_t)posixTime + 3600;
+    struct tm expected;
+    gmtime_r(&local, &expected);
+    CHECK(calendarTime.hour == expected.tm_hour && calendarTime.minute == expected.tm_min && calendarTime.second == expected.tm_sec);
+}
+
+int main()
+{
+    TestSmallDrift();
+    TestClockChanged();
+    TestLargeDrift();
+    TestCalendarTimeAtTick();
+    return nxlightswitch_test::result();
+}
@@ -0,0 +1,230 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Lays thousands of overlapping exceptions, some only on certain days of the
+// week, over two years and checks the calendar against going through the rules
+// for every day. Times building it and looking up the exception in effect and
+// the next boundary, and checks neither loading nor looking up allocates.
+
+#include "test.hpp"
+#include "heaphooks.hpp"
+#include "exceptioncalendar.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
+#include <ctime>
+#include <vector>
+using namespace nxlightswitch;
+
+#define YEAR 2024
+#define LOOKUPS 1000000
+
+// Splitmix64, so the rules are the same on every run
+static u64 NextRandom(u64& state)
+{
+    u64 z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Rules of every kind: ranges of a few days to a few months, repeating, spanning
+// New Year or for one year only, and every third one for some days of the week
+static std::vector<ExceptionRule> MakeRules(u32 count)
+{
+    u64 random = 1;
+    std::vector<ExceptionRule> rules;
+    for (u32 i = 0; i < count; i++)
+    {
+        ExceptionRule rule;
+        u32 kind = NextRandom(random) % 8;
+        rule.year = kind == 0 ? YEAR + (int)(NextRandom(random) % 2) : 0;
+        rule.fromMonth = 1 + NextRandom(random) % 12;
+        rule.fromDay = 1 + NextRandom(random) % 28;
+        u32 length = (kind < 4 ? 1 : kind < 7 ? 10 : 90) * (1 + NextRandom(random) % 4);
+        int months = (rule.fromDay + length) / 28;
+        rule.toMonth = rule.year ? std::min(rule.fromMonth + months, 12) : (rule.fromMonth - 1 + months) % 12 + 1;
+        rule.toDay = 1 + (rule.fromDay + length) % 28;
+        if (rule.year && rule.toMonth * 32 + rule.toDay < rule.fromMonth * 32 + rule.fromDay)
+            rule.toDay = 28;
+        rule.weekdays = i % 3 == 0 ? (u8)(1 + NextRandom(random) % 127) : 0;
+        rule.theme = NextRandom(random) % 2 ? ColorSetId_Dark : ColorSetId_Light;
+        rules.push_back(rule);
+    }
+    return rules;
+}
+
+// Whether a rule covers the given day, going by its dates only
+static bool Covers(const ExceptionRule& rule, const struct tm& date)
+{
+    int day = (date.tm_mon + 1) * 32 + date.tm_mday;
+    int from = rule.fromMonth * 32 + rule.fromDay;
+    int to = rule.toMonth * 32 + rule.toDay;
+    if (rule.year && rule.year != date.tm_year + 1900)
+        return false;
+    bool inRange = from <= to ? day >= from && day <= to : day >= from || day <= to;
+    int weekday = (date.tm_wday + 6) % 7;
+    return inRange && (!rule.weekdays || (rule.weekdays & (1 << weekday)));
+}
+
+// The theme of each day of the two years, 0 for none or 1 + the theme of the
+// last rule covering it
+static std::vector<u8> ReferenceDays(const std::vector<ExceptionRule>& rules, u64 windowStart, u32 dayCount)
+{
+    std::vector<u8> days(dayCount, 0);
+    for (u32 d = 0; d < dayCount; d++)
+    {
+        time_t time = (time_t)(windowStart / MINUTES_PER_DAY + d) * 86400;
+        struct tm date;
+        gmtime_r(&time, &date);
+        for (size_t i = rules.size(); i-- > 0;)
+        {
+            if (Covers(rules[i], date))
+            {
+                days[d] = 1 + (u8)rules[i].theme;
+                break;
+            }
+        }
+    }
+    return days;
+}
+
+static void WriteRules(const std::vector<ExceptionRule>& rules)
+{
+    static const char* names[] = { "mon", "tue", "wed", "thu", "fri", "sat", "sun" };
+    FILE* file = fopen(EXCEPTIONS_PATH, "w");
+    fprintf(file, "[Exceptions]\n");
+    for (size_t i = 0; i < rules.size(); i++)
+    {
+        const ExceptionRule& rule = rules[i];
+        if (rule.year)
+            fprintf(file, "%04d-%02d-%02d to %04d-%02d-%02d = ", rule.year, rule.fromMonth, rule.fromDay, rule.year, rule.toMonth, rule.toDay);
+        else
+            fprintf(file, "%02d-%02d to %02d-%02d = ", rule.fromMonth, rule.fromDay, rule.toMonth, rule.toDay);
+        fputs(rule.theme == ColorSetId_Dark ? "dark" : "light", file);
+        const char* separator = " ";
+        for (int day = 0; day < 7; day++)
+        {
+            if (rule.weekdays & (1 << day))
+            {
+                fprintf(file, "%s%s", separator, names[day]);
+                separator = ", ";
+            }
+        }
+        fputs("\n", file);
+    }
+    fclose(file);
+}
+
+// Checks the theme, and the boundaries around, every day against the reference
+static void CheckDays(const ExceptionCalendar& calendar, const std::vector<u8>& days, u64 windowStart)
+{
+    u32 mismatches = 0;
+    u32 dayCount = days.size();
+    for (u32 d = 0; d < dayCount; d++)
+    {
+        u64 minute = windowStart + d * MINUTES_PER_DAY + 12 * 60;
+        ColorSetId theme;
+        bool found = calendar.Find(minute, &theme);
+        if (found != (days[d] != 0) || (found && 1 + (u8)theme != days[d]))
+            mismatches++;
+
+        // The next day with another theme, or the end of the window if one is forced until then
+        u32 next = d + 1;
+        while (next < dayCount && days[next] == days[d])
+            next++;
+        u64 boundary;
+        bool hasNext = calendar.GetNextBoundary(minute, &boundary);
+        if (next < dayCount || days[d] != 0)
+        {
+            if (!hasNext || boundary != windowStart + next * MINUTES_PER_DAY)
+                mismatches++;
+        }
+        else if (hasNext)
+        {
+            mismatches++;
+        }
+
+        // The first day of this theme, or the start of the window if one is forced since then
+        u32 last = d;
+        while (last > 0 && days[last - 1] == days[d])
+            last--;
+        bool hasLast = calendar.GetLastBoundary(minute, &boundary);
+        if (last > 0 || days[d] != 0)
+        {
+            if (!hasLast || boundary != windowStart + last * MINUTES_PER_DAY)
+                mismatches++;
+        }
+        else if (hasLast)
+        {
+            mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+int main()
+{
+    static ExceptionCalendar calendar;
+    u64 windowStart = Scheduler::MinuteFromCalendar(YEAR, 1, 1, 0, 0);
+    u32 dayCount = (Scheduler::MinuteFromCalendar(YEAR + 2, 1, 1, 0, 0) - windowStart) / MINUTES_PER_DAY;
+
+    // A handful of rules, then the most there may be
+    for (u32 count = 4; count <= EXCEPTIONS_MAX_RULES; count *= 4)
+    {
+        std::vector<ExceptionRule> rules = MakeRules(count);
+        CHECK(calendar.Build(rules, YEAR));
+        CheckDays(calendar, ReferenceDays(rules, windowStart, dayCount), windowStart);
+        CHECK(calendar.Count() <= EXCEPTIONS_MAX_DAYS);
+    }
+
+    // Loading them from the file makes the same calendar, without allocating
+    std::vector<ExceptionRule> rules = MakeRules(EXCEPTIONS_MAX_RULES);
+    std::vector<u8> days = ReferenceDays(rules, windowStart, dayCount);
+    WriteRules(rules);
+    heaphooks::counting = true;
+    double start = nxlightswitch_test::now();
+    CHECK(calendar.Load(EXCEPTIONS_PATH, YEAR));
+    double loadTime = nxlightswitch_test::now() - start;
+    heaphooks::counting = false;
+    CHECK(heaphooks::allocations == 0);
+    CheckDays(calendar, days, windowStart);
+
+    // Look up random minutes of the two years
+    u64 random = 2;
+    std::vector<u64> minutes;
+    for (u32 i = 0; i < LOOKUPS; i++)
+        minutes.push_back(windowStart + NextRandom(random) % (dayCount * MINUTES_PER_DAY));
+
+    heaphooks::counting = true;
+    u32 found = 0;
+    ColorSetId theme;
+    start = nxlightswitch_test::now();
+    for (u32 i = 0; i < LOOKUPS; i++)
+        found += calendar.Find(minutes[i], &theme);
+    double findTime = (nxlightswitch_test::now() - start) / LOOKUPS;
+
+    u64 boundary, sum = 0;
+    start = nxlightswitch_test::now();
+    for (u32 i = 0; i < LOOKUPS; i++)
+        sum += calendar.GetNextBoundary(minutes[i], &boundary) ? boundary - minutes[i] : 0;
+    double boundaryTime = (nxlightswitch_test::now() - start) / LOOKUPS;
+    heaphooks::counting = false;
+    CHECK(heaphooks::allocations == 0);
+
+    printf("%d rules: %d intervals, load %.1f ms, find %.1f ns, next boundary %.1f ns (%u found, %.1f days to the next)\n",
+        EXCEPTIONS_MAX_RULES, (int)calendar.Count(), loadTime / 1e6, findTime, boundaryTime, found,
+        sum / (double)LOOKUPS / MINUTES_PER_DAY);
+
+    // One rule too many is turned down, keeping what was loaded
+    size_t count = calendar.Count();
+    rules.push_back(rules[0]);
+    CHECK(!calendar.Build(rules, YEAR));
+    WriteRules(rules);
+    CHECK(!calendar.Load(EXCEPTIONS_PATH, YEAR));
+    CHECK(calendar.Count() == count);
+    CheckDays(calendar, days, windowStart);
+
+    return nxlightswitch_test::result();
+}
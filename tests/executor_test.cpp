@@ -0,0 +1,268 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Runs many tasks on the executor: periodic ones, ones waiting for events other
+// tasks signal, and ones finishing early. Checks that every task steps on time,
+// then records the run and replays it, which has to step the tasks in the same order.
+
+#include "test.hpp"
+#include "executor.hpp"
+#include "inputtrace.hpp"
+#include <vector>
+using namespace nxlightswitch;
+
+#define PERIODIC_TASKS 30
+#define EVENT_TASK_PAIRS 10
+#define FINISHING_TASKS 5
+#define RUN_SECONDS 600ULL
+#define MS 1000000ULL
+
+// One entry per step: the task's ID, and whether its waiter was signalled
+static std::vector<u32> stepLog;
+
+class LoggingTask : public Task
+{
+public:
+    LoggingTask(u32 id) : id(id), steps(0), lastTick(0), lateSteps(0) {}
+
+    virtual bool Step(bool signalled)
+    {
+        stepLog.push_back(id << 1 | (signalled ? 1 : 0));
+        steps++;
+        return true;
+    }
+
+    u32 id;
+    u32 steps;
+    u64 lastTick;
+    u32 lateSteps;
+};
+
+// Steps every period, and checks it wasn't stepped early or late
+class PeriodicTask : public LoggingTask
+{
+public:
+    PeriodicTask(u32 id, u64 period) : LoggingTask(id), period(period) {}
+
+    virtual bool Step(bool signalled)
+    {
+        LoggingTask::Step(signalled);
+        if (steps > 1 && stub::tick - lastTick != armNsToTicks(period))
+            lateSteps++;
+        lastTick = stub::tick;
+        Sleep(period);
+        return true;
+    }
+
+    u64 period;
+};
+
+// Signals an event every period
+class ProducerTask : public LoggingTask
+{
+public:
+    ProducerTask(u32 id, u64 period, UEvent* event) : LoggingTask(id), period(period), event(event), signals(0) {}
+
+    virtual bool Step(bool signalled)
+    {
+        LoggingTask::Step(signalled);
+        if (steps > 1)
+        {
+            ueventSignal(event);
+            signals++;
+        }
+        Sleep(period);
+        return true;
+    }
+
+    u64 period;
+    UEvent* event;
+    u32 signals;
+};
+
+// Waits for the producer's event, with a timeout longer than its period
+class ConsumerTask : public LoggingTask
+{
+public:
+    ConsumerTask(u32 id, UEvent* event) : LoggingTask(id), event(event), received(0) {}
+
+    virtual bool Step(bool signalled)
+    {
+        LoggingTask::Step(signalled);
+        if (signalled)
+            received++;
+        WaitFor(waiterForUEvent(event), 10000 * MS);
+        return true;
+    }
+
+    UEvent* event;
+    u32 received;
+};
+
+// Finishes after a few steps
+class FinishingTask : public LoggingTask
+{
+public:
+    FinishingTask(u32 id, u32 stepCount) : LoggingTask(id), stepCount(stepCount) {}
+
+    virtual bool Step(bool signalled)
+    {
+        LoggingTask::Step(signalled);
+        Sleep(700 * MS);
+        return steps < stepCount;
+    }
+
+    u32 stepCount;
+};
+
+// Stops the executor after the run
+class StopTask : public LoggingTask
+{
+public:
+    StopTask(u32 id, Executor* executor) : LoggingTask(id), executor(executor) {}
+
+    virtual bool Step(bool signalled)
+    {
+        LoggingTask::Step(signalled);
+        if (steps > 1)
+            executor->Stop();
+        Sleep(RUN_SECONDS * 1000 * MS);
+        return true;
+    }
+
+    Executor* executor;
+};
+
+// Waits for an event once, then signals it itself in a step which doesn't wait
+// for anything, which must not wake the next step as if it had waited for it
+class StaleWaiterTask : public Task
+{
+public:
+    StaleWaiterTask(UEvent* event) : event(event), steps(0), signalledSteps(0) {}
+
+    virtual bool Step(bool signalled)
+    {
+        steps++;
+        signalledSteps += signalled ? 1 : 0;
+        if (steps == 1)
+            WaitFor(waiterForUEvent(event), 10 * MS);
+        else if (steps == 2)
+            ueventSignal(event);
+        return steps < 3;
+    }
+
+    UEvent* event;
+    u32 steps;
+    u32 signalledSteps;
+};
+
+static void TestStepWithoutWait(Platform* platform)
+{
+    UEvent event;
+    ueventCreate(&event, true);
+    Executor executor(platform);
+    StaleWaiterTask task(&event);
+    CHECK(executor.Add(&task));
+    executor.Run();
+    CHECK(task.steps == 3);
+    CHECK(task.signalledSteps == 0);
+
+    // Nobody waited for the event, so it's still signalled
+    CHECK(R_SUCCEEDED(platform->Wait(waiterForUEvent(&event), 0)));
+}
+
+// All tasks of one run
+struct Run
+{
+    Run(Platform* platform) : executor(platform)
+    {
+        u32 id = 0;
+        for (int i = 0; i < PERIODIC_TASKS; i++)
+            periodic.push_back(new PeriodicTask(id++, (100 + 37 * i) * MS));
+        for (int i = 0; i < EVENT_TASK_PAIRS; i++)
+        {
+            ueventCreate(&events[i], true);
+            producers.push_back(new ProducerTask(id++, (250 + 130 * i) * MS, &events[i]));
+            consumers.push_back(new ConsumerTask(id++, &events[i]));
+        }
+        for (int i = 0; i < FINISHING_TASKS; i++)
+            finishing.push_back(new FinishingTask(id++, 3 + i));
+        stop = new StopTask(id++, &executor);
+
+        for (size_t i = 0; i < periodic.size(); i++)
+            CHECK(executor.Add(periodic[i]));
+        for (size_t i = 0; i < producers.size(); i++)
+            CHECK(executor.Add(producers[i]) && executor.Add(consumers[i]));
+        for (size_t i = 0; i < finishing.size(); i++)
+            CHECK(executor.Add(finishing[i]));
+        CHECK(executor.Add(stop));
+    }
+
+    Executor executor;
+    UEvent events[EVENT_TASK_PAIRS];
+    std::vector<PeriodicTask*> periodic;
+    std::vector<ProducerTask*> producers;
+    std::vector<ConsumerTask*> consumers;
+    std::vector<FinishingTask*> finishing;
+    StopTask* stop;
+};
+
+int main()
+{
+    // Live run against the stub, recorded
+    SwitchPlatform switchPlatform;
+    PmForegroundTitleSource titleSource;
+    RecordingPlatform recordingPlatform(&switchPlatform, &titleSource);
+    recordingPlatform.SetRecording(true);
+
+    Run live(&recordingPlatform);
+    live.executor.Run();
+    recordingPlatform.SetRecording(false);
+    std::vector<u32> liveLog = stepLog;
+
+    CHECK(armTicksToNs(stub::tick) / 1000000000ULL == RUN_SECONDS);
+    for (size_t i = 0; i < live.periodic.size(); i++)
+    {
+        PeriodicTask* task = live.periodic[i];
+        CHECK(task->lateSteps == 0);
+        CHECK(task->steps == RUN_SECONDS * 1000 * MS / task->period + 1);
+    }
+    for (size_t i = 0; i < live.producers.size(); i++)
+    {
+        // The last signal may come in the round the executor stopped
+        CHECK(live.consumers[i]->received + 1 >= live.producers[i]->signals && live.consumers[i]->received <= live.producers[i]->signals);
+    }
+    for (size_t i = 0; i < live.finishing.size(); i++)
+        CHECK(live.finishing[i]->steps == live.finishing[i]->stepCount);
+
+    // A full executor takes no more
+    Executor full(&switchPlatform);
+    PeriodicTask extra(0, MS);
+    for (int i = 0; i < EXECUTOR_MAX_TASKS; i++)
+        CHECK(full.Add(&extra));
+    CHECK(!full.Add(&extra));
+
+    // The waiter of one step doesn't stick to the next ones
+    TestStepWithoutWait(&switchPlatform);
+
+    // The replay has to step the same tasks in the same order, without waiting at all
+    stepLog.clear();
+    u64 tickBefore = stub::tick;
+    ReplayPlatform replayPlatform;
+    CHECK(replayPlatform.Load(INPUT_TRACE_PATH));
+    Run replay(&replayPlatform);
+    double start = nxlightswitch_test::now();
+    replay.executor.Run();
+    double replayTime = nxlightswitch_test::now() - start;
+
+    CHECK(stub::tick == tickBefore);
+    CHECK(stepLog == liveLog);
+    CHECK(replayPlatform.GetMismatchCount() == 0);
+    CHECK(replayPlatform.IsFinished());
+
+    printf("%d tasks, %d steps in %llu s, replayed in %.1f ms\n",
+        (int)(PERIODIC_TASKS + 2 * EVENT_TASK_PAIRS + FINISHING_TASKS + 1), (int)liveLog.size(), RUN_SECONDS, replayTime / 1e6);
+    return nxlightswitch_test::result();
+}
@@ -0,0 +1,100 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Checks that flight recorder dumps keep the ones before them, and that a dump
+// request is picked up within a polling interval
+
+#include "test.hpp"
+#include "flightrecorder.hpp"
+#include "tasks.hpp"
+#include <string>
+using namespace nxlightswitch;
+
+static std::string ReadFile(const char* path)
+{
+    std::string text;
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return text;
+    char chunk[512];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        text.append(chunk, read);
+    fclose(file);
+    return text;
+}
+
+static bool Contains(const char* path, const char* text)
+{
+    return ReadFile(path).find(text) != std::string::npos;
+}
+
+// Each dump moves the ones before it back, and the oldest one goes
+static void TestRotation()
+{
+    const char* markers[] = { "Event A", "Event B", "Event C", "Event D" };
+    for (int i = 0; i < 4; i++)
+    {
+        RECORD("%s", markers[i]);
+        CHECK(FlightRecorder::get()->dump());
+    }
+
+    CHECK(Contains("sdmc:/NXLightSwitch.flight.txt", "Event D"));
+    CHECK(Contains("sdmc:/NXLightSwitch.flight.1.txt", "Event C") && !Contains("sdmc:/NXLightSwitch.flight.1.txt", "Event D"));
+    CHECK(Contains("sdmc:/NXLightSwitch.flight.2.txt", "Event B") && !Contains("sdmc:/NXLightSwitch.flight.2.txt", "Event C"));
+    CHECK(ReadFile("sdmc:/NXLightSwitch.flight.3.txt").empty());
+}
+
+// Stops the executor after the given time
+class StopTask : public Task
+{
+public:
+    StopTask(Executor* executor, u64 ns) : executor(executor), ns(ns), started(false) {}
+
+    virtual bool Step(bool signalled)
+    {
+        if (started)
+        {
+            executor->Stop();
+            return false;
+        }
+        started = true;
+        Sleep(ns);
+        return true;
+    }
+
+private:
+    Executor* executor;
+    u64 ns;
+    bool started;
+};
+
+// The request file is looked for once per interval, and removed once handled
+static void TestRequest()
+{
+    remove(FLIGHT_RECORDER_FILE_PATH);
+    RECORD("%s", "Requested event");
+    fclose(fopen(DUMP_REQUEST_PATH, "w"));
+
+    stub::reset();
+    SwitchPlatform platform;
+    Executor executor(&platform);
+    DumpRequestTask dumpRequestTask;
+    StopTask stopTask(&executor, (u64)(DUMP_REQUEST_INTERVAL * 2.5));
+    executor.Add(&dumpRequestTask);
+    executor.Add(&stopTask);
+    executor.Run();
+
+    CHECK(Contains(FLIGHT_RECORDER_FILE_PATH, "Requested event"));
+    CHECK(fopen(DUMP_REQUEST_PATH, "r") == NULL);
+    CHECK(armTicksToNs(stub::tick) >= DUMP_REQUEST_INTERVAL * 2);
+}
+
+int main()
+{
+    TestRotation();
+    TestRequest();
+    return nxlightswitch_test::result();
+}
@@ -0,0 +1,153 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Runs the module on a heap as large as the console gives it, with the title
+// rules and the exceptions at their caps, through a few nightly reloads. Checks
+// everything loads and reloads, that a rules file over the cap is turned down
+// while the rules loaded before stay, and reports the most heap the module took.
+
+#include "test.hpp"
+#include "heaphooks.hpp"
+#include "heap.hpp"
+#include "logger.hpp"
+#include "tasks.hpp"
+#include <string>
+using namespace nxlightswitch;
+
+#define HOUR 3600000000000ULL
+#define GAME_TITLE_ID 0x0100000000010000ULL
+
+// Splitmix64, so the title IDs are the same on every run
+static u64 NextRandom(u64& state)
+{
+    u64 z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Writes the given number of rules, the game's forcing dark and the others random
+static void WriteTitleRules(u32 count)
+{
+    FILE* file = fopen(TITLE_RULES_PATH, "w");
+    fprintf(file, "; Rules for every game in a large library\n[TitleRules]\n%016llX = dark\n", GAME_TITLE_ID);
+    u64 random = 1;
+    for (u32 i = 1; i < count; i++)
+        fprintf(file, "%016llX = %s\n", 0x0100000000000000ULL | (NextRandom(random) & 0x00FFFFFFFFFFF000ULL), i % 2 ? "light" : "dark");
+    fclose(file);
+}
+
+// Writes the given number of exceptions, a week long each, every other one on weekends only
+static void WriteExceptions(u32 count)
+{
+    FILE* file = fopen(EXCEPTIONS_PATH, "w");
+    fprintf(file, "[Exceptions]\n");
+    for (u32 i = 0; i < count; i++)
+        fprintf(file, "%02d-%02d to %02d-%02d = %s%s\n", (int)(1 + i % 12), (int)(1 + i % 20), (int)(1 + i % 12), (int)(8 + i % 20),
+            i % 3 ? "dark" : "light", i % 2 ? " sat, sun" : "");
+    fclose(file);
+}
+
+static std::string ReadLog()
+{
+    std::string log;
+    FILE* file = fopen(LOG_FILE_PATH, "r");
+    if (!file)
+        return log;
+    char chunk[512];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        log.append(chunk, read);
+    fclose(file);
+    return log;
+}
+
+static bool LogHas(const char* text)
+{
+    return ReadLog().find(text) != std::string::npos;
+}
+
+// Stops the executor after the given time
+class StopTask : public Task
+{
+public:
+    StopTask(Executor* executor, u64 ns) : executor(executor), ns(ns), started(false) {}
+
+    virtual bool Step(bool signalled)
+    {
+        if (started)
+        {
+            executor->Stop();
+            return false;
+        }
+        started = true;
+        Sleep(ns);
+        return true;
+    }
+
+private:
+    Executor* executor;
+    u64 ns;
+    bool started;
+};
+
+// Runs the module's tasks for the given hours
+static void Run(Worker* worker, Platform* platform, u32 hours)
+{
+    Executor executor(platform);
+    ModuleTasks tasks(worker);
+    tasks.AddTo(&executor);
+    StopTask stopTask(&executor, hours * HOUR);
+    executor.Add(&stopTask);
+    executor.Run();
+}
+
+int main()
+{
+    FILE* file = fopen(CONFIG_PATH, "w");
+    fputs("[NXLightSwitch]\nLightTime = 07:00\nDarkTime = 19:00\nReloadTime = 03:00\n", file);
+    fclose(file);
+    WriteTitleRules(TITLE_RULES_MAX_COUNT);
+    WriteExceptions(EXCEPTIONS_MAX_RULES);
+
+    // From here on, the module gets no more heap than on the console. It starts
+    // at noon, with the game running.
+    Logger::get()->clearLogFile();
+    stub::reset();
+    stub::posixTimeBase += 12 * 3600;
+    stub::applicationTitleId = GAME_TITLE_ID;
+    heaphooks::ResetPeak();
+    size_t startBytes = heaphooks::liveBytes;
+    heaphooks::budget = startBytes + INNER_HEAP_SIZE;
+
+    SwitchPlatform platform;
+    PmForegroundTitleSource titleSource;
+    Worker worker(&platform, &titleSource);
+    Run(&worker, &platform, 40);
+
+    // Loaded at the start and reloaded at 03:00
+    CHECK(LogHas("Loaded 4096 title rules"));
+    CHECK(LogHas("Reloaded 4096 title rules"));
+    CHECK(LogHas("Loaded 32 exception intervals"));
+    CHECK(LogHas("Reloaded 32 exception intervals"));
+    CHECK(!LogHas("Not enough memory"));
+    CHECK(stub::colorSet == ColorSetId_Dark);
+
+    // One rule too many is turned down at the next reload, keeping the rules
+    WriteTitleRules(TITLE_RULES_MAX_COUNT + 1);
+    Run(&worker, &platform, 24);
+    CHECK(LogHas("Title rules file lists 4097 rules, at most 4096 are supported"));
+    CHECK(stub::colorSet == ColorSetId_Dark);
+    stub::applicationTitleId = 0;
+    Run(&worker, &platform, 4);
+    CHECK(stub::colorSet == ColorSetId_Light);
+
+    heaphooks::budget = 0;
+    printf("%d title rules and %d exceptions: took up to %.1f KiB of the %.1f KiB heap\n", TITLE_RULES_MAX_COUNT, EXCEPTIONS_MAX_RULES,
+        (heaphooks::peakBytes - startBytes) / 1024.0, INNER_HEAP_SIZE / 1024.0);
+    CHECK(heaphooks::peakBytes - startBytes <= INNER_HEAP_SIZE);
+
+    return nxlightswitch_test::result();
+}
@@ -0,0 +1,137 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Replaces malloc and operator new of a test, to count the allocations the
+// module makes and to hold it to a heap budget. Include it from one file only.
+//
+// Allocations are counted through operator new, and through malloc when the
+// module called it directly. The host's stdio allocates its FILEs on its own,
+// so those aren't counted. The budget covers every allocation though, stdio
+// included, like the console's heap does.
+
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+// What the console's allocator adds to each allocation for its bookkeeping
+#define HEAP_HOOKS_CHUNK_OVERHEAD 16
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+extern "C" void __libc_free(void* pointer);
+
+// Start and end of this executable's code, from the linker. The hooks below
+// aren't inlined, so their return address is the caller's.
+extern "C" char __executable_start[];
+extern "C" char etext[];
+
+namespace heaphooks
+{
+    // Whether to count allocations, and how many were counted
+    static bool counting = false;
+    static unsigned allocations = 0;
+
+    // Bytes the live allocations take, the most they took since the last reset,
+    // and the most they may take before malloc fails (0 for no limit)
+    static size_t liveBytes = 0;
+    static size_t peakBytes = 0;
+    static size_t budget = 0;
+
+    inline void CountCaller(void* caller)
+    {
+        if (counting && (char*)caller >= __executable_start && (char*)caller < etext)
+            allocations++;
+    }
+
+    inline size_t ChunkSize(void* pointer)
+    {
+        return pointer ? malloc_usable_size(pointer) + HEAP_HOOKS_CHUNK_OVERHEAD : 0;
+    }
+
+    // Fails an allocation which would take the heap over the budget
+    inline bool Fits(size_t size)
+    {
+        return budget == 0 || liveBytes + size + HEAP_HOOKS_CHUNK_OVERHEAD <= budget;
+    }
+
+    inline void* Taken(void* pointer)
+    {
+        liveBytes += ChunkSize(pointer);
+        if (liveBytes > peakBytes)
+            peakBytes = liveBytes;
+        return pointer;
+    }
+
+    inline void* Allocate(size_t size)
+    {
+        return Fits(size) ? Taken(__libc_malloc(size)) : NULL;
+    }
+
+    inline void Free(void* pointer)
+    {
+        liveBytes -= ChunkSize(pointer);
+        __libc_free(pointer);
+    }
+
+    // Starts measuring the peak from what is live now
+    inline void ResetPeak()
+    {
+        peakBytes = liveBytes;
+    }
+}
+
+extern "C" __attribute__((noinline)) void* malloc(size_t size)
+{
+    heaphooks::CountCaller(__builtin_return_address(0));
+    return heaphooks::Allocate(size);
+}
+
+extern "C" __attribute__((noinline)) void* calloc(size_t count, size_t size)
+{
+    heaphooks::CountCaller(__builtin_return_address(0));
+    if (!heaphooks::Fits(count * size))
+        return NULL;
+    return heaphooks::Taken(__libc_calloc(count, size));
+}
+
+extern "C" __attribute__((noinline)) void* realloc(void* pointer, size_t size)
+{
+    heaphooks::CountCaller(__builtin_return_address(0));
+    size_t oldSize = heaphooks::ChunkSize(pointer);
+    if (!heaphooks::Fits(size))
+        return NULL;
+    void* moved = __libc_realloc(pointer, size);
+    if (moved || size == 0)
+        heaphooks::liveBytes -= oldSize;
+    return moved ? heaphooks::Taken(moved) : NULL;
+}
+
+extern "C" void free(void* pointer)
+{
+    heaphooks::Free(pointer);
+}
+
+void* operator new(size_t size)
+{
+    if (heaphooks::counting)
+        heaphooks::allocations++;
+    void* pointer = heaphooks::Allocate(size ? size : 1);
+    if (!pointer)
+        abort();
+    return pointer;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept { heaphooks::Free(pointer); }
+void operator delete[](void* pointer) noexcept { heaphooks::Free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { heaphooks::Free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { heaphooks::Free(pointer); }
@@ -0,0 +1,205 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Checks that ini_parse_buffer calls its handler with the same sections, names
+// and values, and returns the same error, as the stream parser for the same
+// input: CRLF line ends, no newline at the end, comments, continuation lines
+// and lines longer than the stream parser's line buffer. Times both on a
+// config of several MB.
+
+#include "test.hpp"
+#include "ini/ini.h"
+#include "utils.hpp"
+#include <string>
+#include <vector>
+
+#define BENCHMARK_LINES 100000
+
+// Collects every handler call as "section|name|value" lines
+static int StreamHandler(void* user, const char* section, const char* name, const char* value)
+{
+    std::string* calls = static_cast<std::string*>(user);
+    *calls += std::string(section) + "|" + name + "|" + (value ? value : "<none>") + "\n";
+    return 1;
+}
+
+static std::string SpanString(ini_span span)
+{
+    return span.ptr ? std::string(span.ptr, span.len) : std::string("<none>");
+}
+
+static int BufferHandler(void* user, ini_span section, ini_span name, ini_span value)
+{
+    std::string* calls = static_cast<std::string*>(user);
+    *calls += SpanString(section) + "|" + SpanString(name) + "|" + SpanString(value) + "\n";
+    return 1;
+}
+
+// Feeds a string to ini_parse_stream line by line, like ReadIniLine does with a file
+struct StringStream
+{
+    const char* position;
+    const char* end;
+};
+
+static char* ReadStringLine(char* str, int num, void* stream)
+{
+    StringStream* input = static_cast<StringStream*>(stream);
+    if (input->position == input->end)
+        return NULL;
+    int length = 0;
+    while (input->position < input->end && length < num - 1)
+    {
+        str[length++] = *input->position++;
+        if (str[length - 1] == '\n')
+            break;
+    }
+
+    // Drop the rest of a line longer than the buffer, like ReadIniLine
+    if (length == num - 1 && str[length - 1] != '\n')
+    {
+        while (input->position < input->end && *input->position++ != '\n')
+            ;
+    }
+    str[length] = '\0';
+    return str;
+}
+
+// Parses the input with both parsers and checks they agree
+static void CheckSame(const char* name, const std::string& input)
+{
+    std::string streamCalls, bufferCalls;
+    StringStream stream = { input.data(), input.data() + input.size() };
+    int streamError = ini_parse_stream(ReadStringLine, &stream, StreamHandler, &streamCalls);
+    int bufferError = ini_parse_buffer(input.data(), input.size(), BufferHandler, &bufferCalls);
+    if (streamCalls != bufferCalls || streamError != bufferError)
+    {
+        printf("%s: stream returned %d with\n%sbuffer returned %d with\n%s", name, streamError, streamCalls.c_str(), bufferError,
+            bufferCalls.c_str());
+    }
+    CHECK(streamCalls == bufferCalls);
+    CHECK(streamError == bufferError);
+
+    // ini_parse_string has to agree too, where the input has no zero byte
+    std::string stringCalls;
+    int stringError = ini_parse_string(input.c_str(), StreamHandler, &stringCalls);
+    CHECK(stringCalls == bufferCalls);
+    CHECK(stringError == bufferError);
+}
+
+static void TestEdgeCases()
+{
+    CheckSame("plain", "[NXLightSwitch]\nLightTime = 07:00\nDarkTime = 19:00\n");
+    CheckSame("CRLF", "[NXLightSwitch]\r\nLightTime = 07:00\r\n\r\nDarkTime = 19:00\r\n");
+    CheckSame("no trailing newline", "[NXLightSwitch]\nLightTime = 07:00\nDarkTime = 19:00");
+    CheckSame("CRLF, no trailing newline", "[NXLightSwitch]\r\nDarkTime = 19:00\r");
+    CheckSame("inline comments", "[NXLightSwitch] ; the module\nLightTime = 07:00 ; morning\nDarkTime = 19:00;not a comment\n"
+        "Name = a ; b ; c\nEmpty = ; nothing\n");
+    CheckSame("start comments", "; comment\n# another\n[A]\n  ; indented comment\nKey = Value\n");
+    CheckSame("continuation", "[A]\nKey = first\n  second\n\tthird\nOther = x\n");
+    CheckSame("colon and spacing", "[ A ]\n  Key:Value  \nKey2  =   spaced   value\t\nKey3=\n");
+    CheckSame("BOM", "\xEF\xBB\xBF[A]\nKey = Value\n");
+    CheckSame("no section", "Key = Value\n[B]\nKey = Other\n");
+    CheckSame("missing bracket", "[A\nKey = Value\n");
+    CheckSame("missing delimiter", "[A]\nJust a line\nKey = Value\nAnother line\n");
+    CheckSame("empty", "");
+    CheckSame("blank lines", "\n\n   \n\r\n");
+    CheckSame("title rules", "[TitleRules]\n0100000000010000 = dark\r\n01006A800016E000 = light ; a game\n");
+}
+
+// A line longer than the stream parser's buffer: the buffer parser keeps all of
+// it, where the stream parser keeps its start, and both agree on the rest
+static void TestLongLines()
+{
+    std::string longValue;
+    for (int i = 0; longValue.size() < 4 * INI_MAX_LINE; i++)
+        longValue += "word" + std::to_string(i) + " ";
+    longValue.resize(longValue.size() - 1);
+    std::string input = "[A]\nBefore = 1\nLong = " + longValue + "\r\nAfter = 2\n[B]\nKey = " + longValue;
+
+    std::string streamCalls, bufferCalls;
+    StringStream stream = { input.data(), input.data() + input.size() };
+    int streamError = ini_parse_stream(ReadStringLine, &stream, StreamHandler, &streamCalls);
+    int bufferError = ini_parse_buffer(input.data(), input.size(), BufferHandler, &bufferCalls);
+    CHECK(streamError == 0);
+    CHECK(bufferError == 0);
+    CHECK(bufferCalls == "A|Before|1\nA|Long|" + longValue + "\nA|After|2\nB|Key|" + longValue + "\n");
+
+    // The stream parser cut both long values off at the same place
+    size_t cut = streamCalls.find("\nA|After|2\n");
+    CHECK(cut != std::string::npos);
+    std::string streamLong = streamCalls.substr(0, cut);
+    CHECK(streamLong.compare(0, 18, "A|Before|1\nA|Long|") == 0);
+    streamLong = streamLong.substr(18);
+    CHECK(streamLong.size() < longValue.size());
+    CHECK(longValue.compare(0, streamLong.size(), streamLong) == 0);
+    CHECK(streamCalls.substr(cut) == "\nA|After|2\nB|Key|" + streamLong + "\n");
+}
+
+// Adds up what the handlers see, without keeping it
+static int StreamHashHandler(void* user, const char* section, const char* name, const char* value)
+{
+    u32* hash = static_cast<u32*>(user);
+    *hash = HashBytes(section, strlen(section), *hash);
+    *hash = HashBytes(name, strlen(name), *hash);
+    *hash = HashBytes(value, strlen(value), *hash);
+    return 1;
+}
+
+static int BufferHashHandler(void* user, ini_span section, ini_span name, ini_span value)
+{
+    u32* hash = static_cast<u32*>(user);
+    *hash = HashBytes(section.ptr, section.len, *hash);
+    *hash = HashBytes(name.ptr, name.len, *hash);
+    *hash = HashBytes(value.ptr, value.len, *hash);
+    return 1;
+}
+
+// Times both parsers on a big file, read from the file by the stream parser and
+// from memory by the buffer parser
+static void Benchmark()
+{
+    std::string input = "; A config with a lot in it\r\n";
+    char line[128];
+    for (int i = 0; i < BENCHMARK_LINES; i++)
+    {
+        if (i % 1000 == 0)
+        {
+            snprintf(line, sizeof(line), "[Section%d]\r\n", i / 1000);
+            input += line;
+        }
+        snprintf(line, sizeof(line), "Key%d = some value of line %d ; and a comment about it\r\n", i, i);
+        input += line;
+    }
+
+    FILE* file = fopen("Benchmark.ini", "wb");
+    fwrite(input.data(), 1, input.size(), file);
+    fclose(file);
+
+    u32 streamHash = HASH_BYTES_BASIS;
+    double start = nxlightswitch_test::now();
+    file = fopen("Benchmark.ini", "r");
+    CHECK(ini_parse_stream(ReadIniLine, file, StreamHashHandler, &streamHash) == 0);
+    fclose(file);
+    double streamTime = nxlightswitch_test::now() - start;
+
+    u32 bufferHash = HASH_BYTES_BASIS;
+    start = nxlightswitch_test::now();
+    CHECK(ini_parse_buffer(input.data(), input.size(), BufferHashHandler, &bufferHash) == 0);
+    double bufferTime = nxlightswitch_test::now() - start;
+
+    CHECK(streamHash == bufferHash);
+    double megabytes = input.size() / (1024.0 * 1024.0);
+    printf("%.1f MB: stream %.1f ms (%.0f MB/s), buffer %.1f ms (%.0f MB/s)\n", megabytes, streamTime / 1e6,
+        megabytes / (streamTime / 1e9), bufferTime / 1e6, megabytes / (bufferTime / 1e9));
+}
+
+int main()
+{
+    TestEdgeCases();
+    TestLongLines();
+    Benchmark();
+    return nxlightswitch_test::result();
+}
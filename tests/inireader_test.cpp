@@ -0,0 +1,139 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Checks that looking values up by INIKey doesn't allocate, matches sections and
+// names in any case, and tells apart keys whose hashes collide. Times lookups
+// by INIKey against the string getters on a config with many values.
+
+#include "test.hpp"
+#include "heaphooks.hpp"
+#include "ini/inireader.hpp"
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+#define SECTIONS 16
+#define KEYS_PER_SECTION 64
+#define LOOKUPS 1000000
+
+// The hash is worked out at compile time, the same for any case
+static_assert(INIKey("NXLightSwitch", "LightTime").hash == INIKey("nxlightswitch", "LIGHTTIME").hash,
+    "INIKey hashes have to ignore case");
+static constexpr INIKey lightTimeKey("NXLightSwitch", "LightTime");
+static constexpr INIKey brightnessKey("NXLightSwitch", "DarkBrightness");
+static constexpr INIKey enabledKey("nxlightswitch", "AMBIENTLIGHT");
+static constexpr INIKey missingKey("NXLightSwitch", "NotThere");
+
+// Finds two names in the given section whose "section=name" keys hash the same
+static void FindCollision(const char* section, std::string* first, std::string* second)
+{
+    std::unordered_map<uint32_t, uint32_t> seen;
+    char name[32];
+    for (uint32_t i = 0;; i++)
+    {
+        snprintf(name, sizeof(name), "key%u", i);
+        uint32_t hash = INIKey(section, name).hash;
+        std::unordered_map<uint32_t, uint32_t>::iterator found = seen.find(hash);
+        if (found != seen.end())
+        {
+            *first = "key" + std::to_string(found->second);
+            *second = name;
+            return;
+        }
+        seen[hash] = i;
+    }
+}
+
+// Builds a config with the module's values in mixed case, two names with the
+// same hash, one of another pair, and many more values after them
+static std::string MakeConfig(const std::string& firstCollision, const std::string& secondCollision, const std::string& present)
+{
+    std::string config = "[NXLIGHTSWITCH]\nlighttime = 07:00\nDarkBrightness = 0x20\nAmbientLight = On\n";
+    config += "[Collide]\n" + firstCollision + " = first\n" + secondCollision + " = second\n";
+    config += "[Absent]\n" + present + " = here\n";
+    char line[64];
+    for (int s = 0; s < SECTIONS; s++)
+    {
+        snprintf(line, sizeof(line), "[Section%d]\n", s);
+        config += line;
+        for (int k = 0; k < KEYS_PER_SECTION; k++)
+        {
+            snprintf(line, sizeof(line), "Key%d = %d\n", k, s * KEYS_PER_SECTION + k);
+            config += line;
+        }
+    }
+    return config;
+}
+
+int main()
+{
+    std::string firstCollision, secondCollision;
+    FindCollision("Collide", &firstCollision, &secondCollision);
+    CHECK(INIKey("Collide", firstCollision.c_str()).hash == INIKey("Collide", secondCollision.c_str()).hash);
+    std::string present, absent;
+    FindCollision("Absent", &present, &absent);
+
+    std::string config = MakeConfig(firstCollision, secondCollision, present);
+    INIReader reader(config.data(), config.size());
+    CHECK(reader.ParseError() == 0);
+
+    // Any case finds the values, and the getters read them without allocating
+    heaphooks::counting = true;
+    CHECK(strcmp(reader.Get(lightTimeKey, ""), "07:00") == 0);
+    CHECK(strcmp(reader.GetString(INIKey("nxLightSwitch", "LIGHTTIME"), ""), "07:00") == 0);
+    CHECK(reader.GetInteger(brightnessKey, 0) == 0x20);
+    CHECK(reader.GetReal(brightnessKey, 0) == 0x20);
+    CHECK(reader.GetBoolean(enabledKey, false));
+    CHECK(reader.HasValue(enabledKey));
+    CHECK(strcmp(reader.Get(missingKey, "default"), "default") == 0);
+    CHECK(reader.GetInteger(missingKey, -1) == -1);
+    CHECK(!reader.GetBoolean(missingKey, false));
+    CHECK(!reader.HasValue(missingKey));
+
+    // Keys with the same hash each find their own value, and one that isn't
+    // in the file isn't mistaken for the other
+    CHECK(strcmp(reader.Get(INIKey("Collide", firstCollision.c_str()), ""), "first") == 0);
+    CHECK(strcmp(reader.Get(INIKey("COLLIDE", secondCollision.c_str()), ""), "second") == 0);
+    CHECK(strcmp(reader.Get(INIKey("Absent", present.c_str()), ""), "here") == 0);
+    CHECK(!reader.HasValue(INIKey("Absent", absent.c_str())));
+
+    // Every value of the many sections is found
+    int mismatches = 0;
+    char name[32], section[32];
+    for (int s = 0; s < SECTIONS; s++)
+    {
+        snprintf(section, sizeof(section), "section%d", s);
+        for (int k = 0; k < KEYS_PER_SECTION; k++)
+        {
+            snprintf(name, sizeof(name), "KEY%d", k);
+            if (reader.GetInteger(INIKey(section, name), -1) != s * KEYS_PER_SECTION + k)
+                mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+    heaphooks::counting = false;
+    CHECK(heaphooks::allocations == 0);
+
+    // Time lookups by key against the string getters, which build a std::string per lookup
+    long sum = 0;
+    double start = nxlightswitch_test::now();
+    for (int i = 0; i < LOOKUPS; i++)
+        sum += reader.GetInteger(brightnessKey, 0);
+    double keyTime = (nxlightswitch_test::now() - start) / LOOKUPS;
+
+    heaphooks::allocations = 0;
+    heaphooks::counting = true;
+    start = nxlightswitch_test::now();
+    for (int i = 0; i < LOOKUPS; i++)
+        sum += reader.GetInteger("NXLightSwitch", "DarkBrightness", 0);
+    double stringTime = (nxlightswitch_test::now() - start) / LOOKUPS;
+    heaphooks::counting = false;
+
+    CHECK(sum == 2L * LOOKUPS * 0x20);
+    printf("%d values: INIKey lookup %.1f ns, string lookup %.1f ns (%.1f allocations each)\n", SECTIONS * KEYS_PER_SECTION + 6,
+        keyTime, stringTime, (double)heaphooks::allocations / LOOKUPS);
+
+    return nxlightswitch_test::result();
+}
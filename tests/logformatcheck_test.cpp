@@ -0,0 +1,94 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Checks the compile time format validation, and times the theme change status
+// line formatted with vsprintf like the logger used to, with the bounded
+// snprintf LOG formats with now, and through the whole LOG. The validation
+// costs nothing at runtime and doesn't make formatting any faster.
+
+#include "test.hpp"
+#include "logger.hpp"
+#include <cstdarg>
+#include <cstring>
+using namespace nxlightswitch;
+
+#define ITERATIONS 1000000
+
+// Whether a format matches the given argument types
+template <typename... Args>
+constexpr bool Accepts(const char* format)
+{
+    return LogFormatCheck<LogArgs<Args...> >::Check(format);
+}
+
+static_assert(Accepts<int>("%d"), "int");
+static_assert(Accepts<u64>("%lu") && Accepts<u64>("%llx") && Accepts<size_t>("%zu"), "64-bit integers");
+static_assert(!Accepts<u64>("%u") && !Accepts<int>("%ld"), "64-bit integers need a modifier, others none");
+static_assert(Accepts<double>("%f") && Accepts<double>("%lf") && Accepts<double>("%.2lf") && Accepts<float>("%g"), "floats");
+static_assert(!Accepts<double>("%d") && !Accepts<int>("%f"), "floats and integers don't mix");
+static_assert(Accepts<const char*>("%s") && Accepts<char*>("%-8s") && !Accepts<const char*>("%ls") && !Accepts<int>("%s"), "strings");
+static_assert(Accepts<int, const char*>("%d%% of %s") && Accepts<>("100%%"), "percent signs");
+static_assert(!Accepts<int>("no conversion") && !Accepts<>("%d") && !Accepts<int>("%*d"), "argument count");
+
+// The logger's formatting before the checked LOG, into the buffer it used
+static int FormatWithVsprintf(char* buffer, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int length = vsprintf(buffer, format, args);
+    va_end(args);
+    return length;
+}
+
+int main()
+{
+    // Cut off lines end in "..."
+    char line[2 * LOG_LINE_SIZE];
+    memset(line, 'x', sizeof(line) - 1);
+    line[sizeof(line) - 1] = '\0';
+    LOG("%s", line);
+    Logger::get()->flush();
+    char written[2 * LOG_LINE_SIZE] = {};
+    FILE* file = fopen(LOG_FILE_PATH, "r");
+    if (CHECK(file != NULL))
+    {
+        CHECK(fgets(written, sizeof(written), file) != NULL);
+        fclose(file);
+    }
+    const char* end = strchr(written, '\n');
+    CHECK(end && end - written < LOG_LINE_SIZE + 64 && strncmp(end - 3, "...", 3) == 0);
+
+    // The status line CheckForThemeChange logs
+    const char* themes[] = { "Light", "Dark" };
+    volatile int sink = 0;
+
+    char buffer[1024];
+    double start = nxlightswitch_test::now();
+    for (int i = 0; i < ITERATIONS; i++)
+        sink += FormatWithVsprintf(buffer, "Changed theme to %s", themes[i & 1]);
+    double vsprintfTime = (nxlightswitch_test::now() - start) / ITERATIONS;
+
+    char logBuffer[LOG_LINE_SIZE];
+    start = nxlightswitch_test::now();
+    for (int i = 0; i < ITERATIONS; i++)
+        sink += snprintf(logBuffer, sizeof(logBuffer), "Changed theme to %s", themes[i & 1]);
+    double snprintfTime = (nxlightswitch_test::now() - start) / ITERATIONS;
+
+    // The whole LOG, with the flight recorder and the queue. The writer empties the
+    // queue between batches, outside of the measurement.
+    double logTime = 0;
+    for (int batch = 0; batch < ITERATIONS / LOG_QUEUE_SIZE; batch++)
+    {
+        start = nxlightswitch_test::now();
+        for (int i = 0; i < LOG_QUEUE_SIZE; i++)
+            LOG("Changed theme to %s", themes[i & 1]);
+        logTime += nxlightswitch_test::now() - start;
+        Logger::get()->flush();
+    }
+    logTime /= ITERATIONS / LOG_QUEUE_SIZE * LOG_QUEUE_SIZE;
+
+    printf("Status line: vsprintf %.1f ns, bounded snprintf %.1f ns, whole LOG %.1f ns\n", vsprintfTime, snprintfTime, logTime);
+    return nxlightswitch_test::result();
+}
@@ -0,0 +1,246 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Hammers the log queue, and then the whole logger, with many producer threads
+// against one writer. Checks that every line gets through the queue whole and
+// in order per producer, that a burst of lines from every thread is written
+// whole without dropping any, and that a flood writes every line whole or
+// counts it as dropped. Reports how the throughput scales with the number of
+// producers.
+
+#include "test.hpp"
+#include "logger.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+using namespace nxlightswitch;
+
+#define LINES_PER_PRODUCER 200000
+#define LOGGED_LINES_PER_PRODUCER 20000
+#define BURST_LINES_PER_PRODUCER 200
+#define BURST_FLUSH_INTERVAL_NS 1000000
+#define MAX_PRODUCERS 8
+
+// Pushes numbered lines, trying again after the others had a go while the
+// queue is full, and counts how often it was full
+static void Produce(LogQueue* queue, u32 producer, std::atomic<u32>* pushed, std::atomic<u32>* full)
+{
+    char text[64];
+    for (u32 i = 0; i < LINES_PER_PRODUCER; i++)
+    {
+        int length = snprintf(text, sizeof(text), "producer %u line %u check %u", producer, i, producer * 2654435761u ^ i);
+        while (!queue->Push(i, text, length))
+        {
+            full->fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+        pushed->fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Runs the given number of producers against one reader
+static void StressQueue(u32 producers)
+{
+    static LogQueue queue;
+    std::atomic<u32> pushed(0), full(0), done(0);
+    u32 popped = 0, corrupted = 0, reordered = 0;
+    s64 lastLine[MAX_PRODUCERS];
+    for (u32 i = 0; i < MAX_PRODUCERS; i++)
+        lastLine[i] = -1;
+
+    double start = nxlightswitch_test::now();
+    std::vector<std::thread> threads;
+    for (u32 p = 0; p < producers; p++)
+        threads.push_back(std::thread([&, p]() { Produce(&queue, p, &pushed, &full); done++; }));
+
+    LogRecord record;
+    while (true)
+    {
+        // Only stop once all producers are done and the queue is empty
+        bool finished = done.load() == producers;
+        if (!queue.Pop(&record))
+        {
+            if (finished)
+                break;
+            std::this_thread::yield();
+            continue;
+        }
+        popped++;
+
+        char text[LOG_LINE_SIZE + 1];
+        memcpy(text, record.text, record.length);
+        text[record.length] = '\0';
+        unsigned producer, line, check;
+        if (sscanf(text, "producer %u line %u check %u", &producer, &line, &check) != 3 || producer >= producers
+            || line != record.tick || check != (producer * 2654435761u ^ line))
+        {
+            corrupted++;
+            continue;
+        }
+        if ((s64)line <= lastLine[producer])
+            reordered++;
+        lastLine[producer] = line;
+    }
+    double seconds = (nxlightswitch_test::now() - start) / 1e9;
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    CHECK(corrupted == 0);
+    CHECK(reordered == 0);
+    CHECK(popped == pushed.load());
+    CHECK(popped == producers * LINES_PER_PRODUCER);
+    printf("Queue, %u producers: %.2fM lines/s through, found it full %.2f times per line\n", producers, popped / seconds / 1e6,
+        (double)full.load() / popped);
+}
+
+// What the log says, going through it line by line
+struct LogContents
+{
+    u32 lines;
+    u32 dropped;
+    u32 broken;
+    u32 reordered;
+    u32 skipped;
+};
+
+// Reads the log back. Every line has to be whole, a timestamp and either a line
+// a producer logged or a note of dropped lines, and each producer's lines have
+// to come in order. Counts the lines, the ones dropped, and the ones missing
+// out of the given number each producer logged.
+static LogContents ReadLog(u32 producers, u32 linesPerProducer)
+{
+    LogContents contents = {};
+    s64 lastLine[MAX_PRODUCERS];
+    for (u32 i = 0; i < MAX_PRODUCERS; i++)
+        lastLine[i] = -1;
+
+    FILE* file = fopen(LOG_FILE_PATH, "r");
+    if (!file)
+        return contents;
+    char line[LOG_LINE_SIZE + 64];
+    char expected[LOG_LINE_SIZE + 64];
+    while (fgets(line, sizeof(line), file))
+    {
+        int day, month, year, hour, minute, second, offset = 0;
+        if (sscanf(line, "%2d-%2d-%4d %2d:%2d:%2d: %n", &day, &month, &year, &hour, &minute, &second, &offset) != 6 || offset == 0)
+        {
+            contents.broken++;
+            continue;
+        }
+        int producer, number;
+        if (sscanf(line + offset, "Dropped %d log lines", &number) == 1)
+        {
+            snprintf(expected, sizeof(expected), "%02d-%02d-%04d %02d:%02d:%02d: Dropped %d log lines, the log queue was full\n",
+                day, month, year, hour, minute, second, number);
+            if (strcmp(line, expected) != 0)
+                contents.broken++;
+            else
+                contents.dropped += number;
+            continue;
+        }
+        if (sscanf(line + offset, "Producer %d logged line %d", &producer, &number) != 2 || producer < 0 || producer >= (int)producers)
+        {
+            contents.broken++;
+            continue;
+        }
+        snprintf(expected, sizeof(expected), "%02d-%02d-%04d %02d:%02d:%02d: Producer %d logged line %d\n",
+            day, month, year, hour, minute, second, producer, number);
+        if (strcmp(line, expected) != 0)
+        {
+            contents.broken++;
+            continue;
+        }
+        contents.lines++;
+        if (number <= lastLine[producer])
+            contents.reordered++;
+        else
+            contents.skipped += number - lastLine[producer] - 1;
+        lastLine[producer] = number;
+    }
+    fclose(file);
+    for (u32 p = 0; p < producers; p++)
+        contents.skipped += linesPerProducer - 1 - lastLine[p];
+    return contents;
+}
+
+// Logs the given number of lines through LOG from the given number of threads,
+// while the writer flushes every given number of nanoseconds. Returns how many
+// lines per second were logged.
+static double LogFrom(u32 producers, u32 linesPerProducer, u64 flushInterval)
+{
+    Logger::get()->clearLogFile();
+    std::atomic<u32> done(0);
+
+    // The writer runs before anything logs, as it does once the module is up.
+    // Until it first ran, there's no writer to wait for.
+    Logger::get()->flush();
+
+    double start = nxlightswitch_test::now();
+    std::vector<std::thread> threads;
+    for (u32 p = 0; p < producers; p++)
+    {
+        threads.push_back(std::thread([&, p]()
+        {
+            for (u32 i = 0; i < linesPerProducer; i++)
+                LOG("Producer %d logged line %d", (int)p, (int)i);
+            done++;
+        }));
+    }
+    while (done.load() < producers)
+    {
+        Logger::get()->flush();
+        if (flushInterval)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(flushInterval));
+        else
+            std::this_thread::yield();
+    }
+    Logger::get()->flush();
+    double seconds = (nxlightswitch_test::now() - start) / 1e9;
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    return producers * linesPerProducer / seconds;
+}
+
+// A burst many times the queue's size, from every producer at once, with the
+// writer waking up about as often as on the console: nothing gets dropped
+static void BurstLogger(u32 producers)
+{
+    LogFrom(producers, BURST_LINES_PER_PRODUCER, BURST_FLUSH_INTERVAL_NS);
+    LogContents contents = ReadLog(producers, BURST_LINES_PER_PRODUCER);
+    printf("Logger, burst of %u lines from %u producers: %u written, %u dropped\n", producers * BURST_LINES_PER_PRODUCER,
+        producers, contents.lines, contents.dropped);
+    CHECK(contents.broken == 0);
+    CHECK(contents.reordered == 0);
+    CHECK(contents.skipped == 0);
+    CHECK(contents.dropped == 0);
+    CHECK(contents.lines == producers * BURST_LINES_PER_PRODUCER);
+}
+
+// Floods the logger far faster than any file takes lines in: every line logged
+// is either written whole or counted as dropped
+static void FloodLogger(u32 producers)
+{
+    double rate = LogFrom(producers, LOGGED_LINES_PER_PRODUCER, 0);
+    LogContents contents = ReadLog(producers, LOGGED_LINES_PER_PRODUCER);
+    printf("Logger, flood from %u producers: %.2fM lines/s logged, %u written, %u dropped\n", producers, rate / 1e6,
+        contents.lines, contents.dropped);
+    CHECK(contents.broken == 0);
+    CHECK(contents.reordered == 0);
+    CHECK(contents.skipped == contents.dropped);
+    CHECK(contents.lines + contents.dropped == producers * LOGGED_LINES_PER_PRODUCER);
+    CHECK(contents.lines > 0);
+}
+
+int main()
+{
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    for (u32 producers = 1; producers <= MAX_PRODUCERS; producers *= 2)
+        StressQueue(producers);
+    for (u32 producers = 1; producers <= MAX_PRODUCERS; producers *= 2)
+        BurstLogger(producers);
+    for (u32 producers = 1; producers <= MAX_PRODUCERS; producers *= 2)
+        FloodLogger(producers);
+    return nxlightswitch_test::result();
+}
@@ -0,0 +1,99 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Records the whole module through a day and a bit against the libnx stub, with
+// a game starting, the theme changed by hand and setsys failing for a while, then
+// replays the recording. The replay has to make the same decisions at the same
+// times without any mismatch.
+
+#include "test.hpp"
+#include "inputtrace.hpp"
+#include "tasks.hpp"
+using namespace nxlightswitch;
+
+#define HOUR 3600000000000ULL
+#define GAME_TITLE_ID 0x0100000000010000ULL
+
+// Changes the console's state once per hour, and stops the executor after the run
+class ScenarioTask : public Task
+{
+public:
+    ScenarioTask(Executor* executor) : executor(executor), hour(0) {}
+
+    virtual bool Step(bool signalled)
+    {
+        switch (hour++)
+        {
+        case 3: stub::applicationTitleId = GAME_TITLE_ID; break;
+        case 4: stub::applicationTitleId = 0; break;
+        case 5: stub::colorSet = ColorSetId_Dark; break;
+        case 20: stub::getColorSetResult = MAKERESULT(Module_Libnx, LibnxError_IoError); break;
+        case 22: stub::getColorSetResult = 0; break;
+        case 23: stub::timeResult = MAKERESULT(Module_Libnx, LibnxError_IoError); break;
+        case 24: stub::timeResult = 0; break;
+        case 30: executor->Stop(); break;
+        }
+        Sleep(HOUR);
+        return true;
+    }
+
+private:
+    Executor* executor;
+    u32 hour;
+};
+
+int main()
+{
+    FILE* file = fopen(CONFIG_PATH, "w");
+    fputs("[NXLightSwitch]\nLightTime = 07:00\nDarkTime = 19:00\nLightBrightness = 0.8\nDarkBrightness = 0.3\n"
+        "RecordInputs = true\nClockResyncInterval = 600\n", file);
+    fclose(file);
+    file = fopen(TITLE_RULES_PATH, "w");
+    fprintf(file, "[TitleRules]\n%016llX = dark\n", GAME_TITLE_ID);
+    fclose(file);
+
+    // Boot at 06:00, recording from the start
+    stub::reset();
+    stub::posixTimeBase += 6 * 3600;
+    u32 liveDecisions;
+    {
+        SwitchPlatform switchPlatform;
+        PmForegroundTitleSource titleSource;
+        RecordingPlatform platform(&switchPlatform, &titleSource);
+        Worker worker(&platform, &platform);
+        Executor executor(&platform);
+        ModuleTasks tasks(&worker);
+        tasks.AddTo(&executor);
+        ScenarioTask scenario(&executor);
+        executor.Add(&scenario);
+        executor.Run();
+        platform.SetRecording(false);
+
+        liveDecisions = stub::setColorSetCalls + stub::brightnessCalls;
+        CHECK(stub::colorSet == ColorSetId_Light);
+        CHECK(stub::setColorSetCalls >= 4);
+    }
+
+    // Replay with a fresh console state, which the replay mustn't look at
+    stub::reset();
+    ReplayPlatform platform;
+    CHECK(platform.Load(INPUT_TRACE_PATH));
+    Worker worker(&platform, &platform);
+    Executor executor(&platform);
+    ModuleTasks tasks(&worker);
+    tasks.AddTo(&executor);
+    ScenarioTask scenario(&executor);
+    executor.Add(&scenario);
+    platform.StopAtEnd(&executor);
+    executor.Run();
+
+    printf("%d decisions, %d mismatches\n", (int)platform.GetDecisionCount(), (int)platform.GetMismatchCount());
+    CHECK(platform.GetDecisionCount() == liveDecisions);
+    CHECK(platform.GetMismatchCount() == 0);
+    CHECK(platform.IsFinished());
+    CHECK(stub::setColorSetCalls == 0 && stub::tick == 0);
+
+    return nxlightswitch_test::result();
+}
@@ -0,0 +1,286 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Schedules, cancels and advances through thousands of one-off and repeating
+// actions spread over weeks, so they go through level 1 and the overflow list,
+// and checks every action runs at its minute, in order, against a sorted list
+// of what is due. Then times scheduling, cancelling, finding the next expiry
+// and advancing with 10000 actions.
+
+#include "test.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
+#include <utility>
+#include <vector>
+using namespace nxlightswitch;
+
+#define RANDOM_ACTIONS 2000
+#define RANDOM_STEPS 3000
+#define BENCHMARK_ACTIONS 10000
+
+// Minutes the two wheel levels cover, past that actions go into the overflow list
+#define WHEEL_MINUTES (SCHEDULER_LEVEL0_SLOTS * SCHEDULER_LEVEL1_SLOTS)
+
+// Splitmix64, so the actions are the same on every run
+static u64 NextRandom(u64& state)
+{
+    u64 z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// What the reference knows about an action
+struct ReferenceAction
+{
+    u64 expiry;
+    u32 period;
+    ScheduleHandle handle;
+    bool live;
+};
+
+// Runs of the actions as (minute, action), in the order they happened
+typedef std::vector<std::pair<u64, u32> > Runs;
+
+struct RunLog
+{
+    Scheduler* scheduler;
+    Runs runs;
+};
+
+static void RecordRun(void* context, u32 argument)
+{
+    RunLog* log = static_cast<RunLog*>(context);
+    log->runs.push_back(std::make_pair(log->scheduler->GetCurrentMinute(), argument));
+}
+
+// The runs due up to the given minute, sorted by minute and action, moving the
+// reference's repeating actions on like the scheduler does
+static Runs ReferenceAdvance(std::vector<ReferenceAction>& reference, u64 nowMinute)
+{
+    Runs due;
+    for (u32 i = 0; i < reference.size(); i++)
+    {
+        ReferenceAction& action = reference[i];
+        if (!action.live || action.expiry > nowMinute)
+            continue;
+        due.push_back(std::make_pair(action.expiry, i));
+        if (!action.period)
+        {
+            action.live = false;
+            continue;
+        }
+        action.expiry += action.period;
+        if (action.expiry <= nowMinute)
+            action.expiry += ((nowMinute - action.expiry) / action.period + 1) * action.period;
+    }
+    std::sort(due.begin(), due.end());
+    return due;
+}
+
+static bool ReferenceNextExpiry(const std::vector<ReferenceAction>& reference, u64* minute)
+{
+    bool found = false;
+    for (u32 i = 0; i < reference.size(); i++)
+    {
+        if (reference[i].live && (!found || reference[i].expiry < *minute))
+        {
+            *minute = reference[i].expiry;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Picks a minute ahead: mostly within the day, often within the wheel, and
+// sometimes weeks ahead in the overflow list
+static u64 RandomDelay(u64& random)
+{
+    switch (NextRandom(random) % 4)
+    {
+    case 0: return NextRandom(random) % SCHEDULER_LEVEL0_SLOTS;
+    case 1: return NextRandom(random) % MINUTES_PER_DAY;
+    case 2: return NextRandom(random) % WHEEL_MINUTES;
+    default: return WHEEL_MINUTES + NextRandom(random) % (2 * WHEEL_MINUTES);
+    }
+}
+
+static void TestAgainstReference()
+{
+    static Scheduler scheduler;
+    u64 start = Scheduler::MinuteFromCalendar(2024, 3, 1, 13, 37);
+    scheduler.Reset(start);
+    RunLog log;
+    log.scheduler = &scheduler;
+    std::vector<ReferenceAction> reference;
+    u64 random = 1;
+    u32 overflowScheduled = 0, runCount = 0, nextMismatches = 0, orderMismatches = 0;
+
+    for (u32 step = 0; step < RANDOM_STEPS; step++)
+    {
+        u64 now = scheduler.GetCurrentMinute();
+
+        // Schedule a few actions, a third of them repeating daily, weekly or at odd periods
+        u32 toSchedule = reference.size() < RANDOM_ACTIONS ? 1 + NextRandom(random) % 3 : 0;
+        for (u32 i = 0; i < toSchedule; i++)
+        {
+            ReferenceAction action;
+            action.expiry = now + RandomDelay(random);
+            u32 kind = NextRandom(random) % 9;
+            action.period = kind == 0 ? MINUTES_PER_DAY : kind == 1 ? MINUTES_PER_WEEK : kind == 2 ? 1 + NextRandom(random) % 5000 : 0;
+            action.live = true;
+            action.handle = scheduler.Schedule(action.expiry, action.period, RecordRun, &log, (u32)reference.size());
+            overflowScheduled += action.expiry - now >= WHEEL_MINUTES;
+            reference.push_back(action);
+        }
+
+        // Cancel one now and then
+        if (NextRandom(random) % 4 == 0)
+        {
+            u32 victim = NextRandom(random) % reference.size();
+            if (reference[victim].live)
+            {
+                scheduler.Cancel(reference[victim].handle);
+                reference[victim].live = false;
+            }
+        }
+
+        u64 expected = 0, next;
+        bool hasExpected = ReferenceNextExpiry(reference, &expected);
+        bool hasNext = scheduler.GetNextExpiry(&next);
+        if (hasNext != hasExpected || (hasNext && next != expected))
+            nextMismatches++;
+
+        // Move on by anything from a minute to a few days
+        u64 target = now + (NextRandom(random) % 2 ? 1 + NextRandom(random) % 90 : NextRandom(random) % (4 * MINUTES_PER_DAY));
+        Runs due = ReferenceAdvance(reference, target);
+        log.runs.clear();
+        scheduler.Advance(target);
+
+        // Actions due the same minute may run in any order among themselves
+        Runs runs = log.runs;
+        for (size_t i = 1; i < runs.size(); i++)
+        {
+            if (runs[i].first < runs[i - 1].first)
+                orderMismatches++;
+        }
+        std::sort(runs.begin(), runs.end());
+        if (runs != due)
+            orderMismatches++;
+        runCount += runs.size();
+        CHECK(scheduler.GetCurrentMinute() == target);
+    }
+
+    CHECK(nextMismatches == 0);
+    CHECK(orderMismatches == 0);
+    CHECK(overflowScheduled > 0);
+    printf("%u steps, %u actions (%u past the wheel), %u runs\n", RANDOM_STEPS, (u32)reference.size(), overflowScheduled, runCount);
+}
+
+// An action which cancels another one due the same minute, and schedules a new one
+struct Chain
+{
+    Scheduler* scheduler;
+    ScheduleHandle victim;
+    u32 runs;
+};
+
+static void CountRun(void* context, u32 argument)
+{
+    static_cast<Chain*>(context)->runs += argument;
+}
+
+static void RunChain(void* context, u32 argument)
+{
+    Chain* chain = static_cast<Chain*>(context);
+    chain->scheduler->Cancel(chain->victim);
+    chain->scheduler->Schedule(chain->scheduler->GetCurrentMinute() + WHEEL_MINUTES + 5, 0, CountRun, chain, 100);
+}
+
+// Actions may cancel and schedule others while they run
+static void TestActionsChangingTheWheel()
+{
+    static Scheduler scheduler;
+    scheduler.Reset(1000);
+    Chain chain = { &scheduler, -1, 0 };
+
+    // The victim is pushed first, so the chain action at its head runs first
+    chain.victim = scheduler.Schedule(1010, 0, CountRun, &chain, 1);
+    scheduler.Schedule(1010, 0, RunChain, &chain, 0);
+    scheduler.Advance(1010);
+    CHECK(chain.runs == 0);
+
+    // The action it scheduled goes into the overflow list and still runs on time
+    u64 next;
+    CHECK(scheduler.GetNextExpiry(&next) && next == 1010 + WHEEL_MINUTES + 5);
+    scheduler.Advance(1010 + WHEEL_MINUTES + 4);
+    CHECK(chain.runs == 0);
+    scheduler.Advance(1010 + WHEEL_MINUTES + 5);
+    CHECK(chain.runs == 100);
+    CHECK(!scheduler.GetNextExpiry(&next));
+}
+
+static void Benchmark()
+{
+    static Scheduler scheduler;
+    u64 start = Scheduler::MinuteFromCalendar(2024, 1, 1, 0, 0);
+    RunLog log;
+    log.scheduler = &scheduler;
+    u64 random = 3;
+
+    // Spread over three weeks, a third of them past the wheel
+    std::vector<u64> minutes;
+    for (u32 i = 0; i < BENCHMARK_ACTIONS; i++)
+        minutes.push_back(start + NextRandom(random) % (3 * MINUTES_PER_WEEK));
+    scheduler.Reset(start);
+    std::vector<ScheduleHandle> handles;
+    double begin = nxlightswitch_test::now();
+    for (u32 i = 0; i < BENCHMARK_ACTIONS; i++)
+        handles.push_back(scheduler.Schedule(minutes[i], 0, RecordRun, &log, i));
+    double scheduleTime = (nxlightswitch_test::now() - begin) / BENCHMARK_ACTIONS;
+
+    u64 next, sum = 0;
+    begin = nxlightswitch_test::now();
+    for (u32 i = 0; i < BENCHMARK_ACTIONS; i++)
+        sum += scheduler.GetNextExpiry(&next) ? next : 0;
+    double nextTime = (nxlightswitch_test::now() - begin) / BENCHMARK_ACTIONS;
+
+    begin = nxlightswitch_test::now();
+    for (u32 i = 0; i < BENCHMARK_ACTIONS; i += 2)
+        scheduler.Cancel(handles[i]);
+    double cancelTime = (nxlightswitch_test::now() - begin) / (BENCHMARK_ACTIONS / 2);
+
+    // Going minute by minute, like the module does when it wakes up for every action
+    log.runs.reserve(BENCHMARK_ACTIONS);
+    u32 minutesAdvanced = 0;
+    begin = nxlightswitch_test::now();
+    for (u64 minute = start + 1; minute <= start + 3 * MINUTES_PER_WEEK; minute++, minutesAdvanced++)
+        scheduler.Advance(minute);
+    double advanceTime = (nxlightswitch_test::now() - begin) / minutesAdvanced;
+    CHECK(log.runs.size() == BENCHMARK_ACTIONS / 2);
+    CHECK(!scheduler.GetNextExpiry(&next));
+
+    // GetNextExpiry scans the earliest slot for its minimum, so actions crowding
+    // into one 64 minute block ahead make it linear in their number
+    scheduler.Reset(start);
+    for (u32 i = 0; i < BENCHMARK_ACTIONS; i++)
+        scheduler.Schedule(start + 10 * SCHEDULER_LEVEL0_SLOTS + i % SCHEDULER_LEVEL0_SLOTS, 0, RecordRun, &log, i);
+    begin = nxlightswitch_test::now();
+    for (u32 i = 0; i < BENCHMARK_ACTIONS; i++)
+        sum += scheduler.GetNextExpiry(&next) ? next : 0;
+    double crowdedNextTime = (nxlightswitch_test::now() - begin) / BENCHMARK_ACTIONS;
+    CHECK(sum > 0);
+
+    printf("%d actions: schedule %.1f ns, cancel %.1f ns, next expiry %.1f ns (%.0f ns all in one block), advance %.1f ns per minute\n",
+        BENCHMARK_ACTIONS, scheduleTime, cancelTime, nextTime, crowdedNextTime, advanceTime);
+}
+
+int main()
+{
+    TestAgainstReference();
+    TestActionsChangingTheWheel();
+    Benchmark();
+    return nxlightswitch_test::result();
+}
@@ -0,0 +1,95 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Checks that a journal written to without loading it first carries on from the
+// newest record in the file, so it never overwrites that one, and that a torn
+// slot is written over while the record before it stays
+
+#include "test.hpp"
+#include "statejournal.hpp"
+#include <cstdio>
+using namespace nxlightswitch;
+
+// Writes the given number of records, each one minute after the last
+static void WriteRecords(StateJournal& journal, u32 count, u64 firstMinute)
+{
+    for (u32 i = 0; i < count; i++)
+        CHECK(journal.Write(ColorSetId_Dark, firstMinute + i, 0x1234, false));
+}
+
+// Loads the journal afresh, as the module does after a restart
+static bool LoadNewest(StateRecord* record)
+{
+    StateJournal journal;
+    return journal.Load(record);
+}
+
+// A journal which wasn't loaded picks up the sequence from the file
+static void TestWriteWithoutLoad()
+{
+    remove(STATE_JOURNAL_PATH);
+    StateJournal first;
+    WriteRecords(first, 3, 100);
+
+    StateRecord record;
+    CHECK(LoadNewest(&record));
+    CHECK(record.sequence == 3);
+    CHECK(record.minute == 102);
+
+    // Writing the next record leaves the newest one from before alone
+    StateJournal second;
+    CHECK(second.Write(ColorSetId_Light, 200, 0x1234, true));
+    CHECK(LoadNewest(&record));
+    CHECK(record.sequence == 4);
+    CHECK(record.minute == 200);
+    CHECK(record.theme == ColorSetId_Light);
+    CHECK(record.overridden == 1);
+
+    // And the one after goes where the old newest record was
+    CHECK(second.Write(ColorSetId_Dark, 201, 0x1234, false));
+    CHECK(LoadNewest(&record));
+    CHECK(record.sequence == 5);
+    CHECK(record.minute == 201);
+}
+
+// A torn newest slot gets written over, keeping the valid record next to it
+static void TestTornSlot()
+{
+    remove(STATE_JOURNAL_PATH);
+    StateJournal first;
+    WriteRecords(first, 2, 100);
+
+    // Tear the newest record, in slot 2 % STATE_JOURNAL_SLOTS
+    FILE* file = fopen(STATE_JOURNAL_PATH, "r+b");
+    fseek(file, (long)(2 % STATE_JOURNAL_SLOTS * sizeof(StateRecord) + 8), SEEK_SET);
+    fputc(0xFF, file);
+    fclose(file);
+
+    StateRecord record;
+    CHECK(LoadNewest(&record));
+    CHECK(record.sequence == 1);
+    CHECK(record.minute == 100);
+
+    StateJournal second;
+    CHECK(second.Write(ColorSetId_Light, 300, 0x1234, false));
+    CHECK(LoadNewest(&record));
+    CHECK(record.sequence == 2);
+    CHECK(record.minute == 300);
+
+    // The record before the torn one is still there to fall back to
+    file = fopen(STATE_JOURNAL_PATH, "rb");
+    StateRecord slots[STATE_JOURNAL_SLOTS];
+    CHECK(fread(slots, sizeof(StateRecord), STATE_JOURNAL_SLOTS, file) == STATE_JOURNAL_SLOTS);
+    fclose(file);
+    CHECK(slots[1 % STATE_JOURNAL_SLOTS].sequence == 1);
+    CHECK(slots[1 % STATE_JOURNAL_SLOTS].minute == 100);
+}
+
+int main()
+{
+    TestWriteWithoutLoad();
+    TestTornSlot();
+    return nxlightswitch_test::result();
+}
@@ -0,0 +1,279 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#include <switch.h>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+
+namespace stub
+{
+    std::atomic<u64> tick(0);
+    u64 posixTimeBase;
+    s32 utcOffset;
+    Result timeResult;
+    u32 timeCalls;
+    ColorSetId colorSet;
+    Result getColorSetResult;
+    Result setColorSetResult;
+    u32 getColorSetCalls;
+    u32 setColorSetCalls;
+    float brightness;
+    u32 brightnessCalls;
+    float lux;
+    float (*luxAt)(u64 ns);
+    Result ambientLightResult;
+    u32 ambientLightCalls;
+    u64 applicationTitleId;
+
+    void advance(u64 ns)
+    {
+        tick += armNsToTicks(ns);
+    }
+
+    void reset()
+    {
+        tick = 0;
+        // Monday, 1 January 2024, 00:00 UTC
+        posixTimeBase = 1704067200;
+        utcOffset = 0;
+        timeResult = 0;
+        timeCalls = 0;
+        colorSet = ColorSetId_Light;
+        getColorSetResult = 0;
+        setColorSetResult = 0;
+        getColorSetCalls = 0;
+        setColorSetCalls = 0;
+        brightness = 0.5f;
+        brightnessCalls = 0;
+        lux = 100.0f;
+        luxAt = NULL;
+        ambientLightResult = 0;
+        ambientLightCalls = 0;
+        applicationTitleId = 0;
+    }
+
+    // Sets the defaults before main runs
+    static struct Defaults { Defaults() { reset(); } } defaults;
+}
+
+extern "C" {
+
+Result smInitialize(void) { return 0; }
+void smExit(void) {}
+Result fsInitialize(void) { return 0; }
+void fsExit(void) {}
+Result fsdevMountSdmc(void) { return 0; }
+int fsdevUnmountAll(void) { return 0; }
+Result timeInitialize(void) { return 0; }
+void timeExit(void) {}
+Result setInitialize(void) { return 0; }
+void setExit(void) {}
+Result setsysInitialize(void) { return 0; }
+void setsysExit(void) {}
+Result lblInitialize(void) { return 0; }
+void lblExit(void) {}
+Result pmdmntInitialize(void) { return 0; }
+void pmdmntExit(void) {}
+Result pminfoInitialize(void) { return 0; }
+void pminfoExit(void) {}
+
+void fatalThrow(Result res)
+{
+    fprintf(stderr, "fatalThrow(0x%x)\n", res);
+    abort();
+}
+
+u64 armGetSystemTick(void)
+{
+    return stub::tick;
+}
+
+// The system tick runs at 19.2 MHz
+u64 armTicksToNs(u64 ticks)
+{
+    return (ticks * 625) / 12;
+}
+
+u64 armNsToTicks(u64 ns)
+{
+    return (ns * 12) / 625;
+}
+
+Handle threadGetCurHandle(void)
+{
+    static std::atomic<u32> nextHandle(0xE000);
+    static thread_local Handle handle = nextHandle++;
+    return handle;
+}
+
+void svcSleepThread(s64 nano)
+{
+    std::this_thread::sleep_for(std::chrono::nanoseconds(nano));
+}
+
+Result timeGetCurrentTime(TimeType type, u64* timestamp)
+{
+    (void)type;
+    stub::timeCalls++;
+    if (R_FAILED(stub::timeResult))
+        return stub::timeResult;
+    *timestamp = stub::posixTimeBase + armTicksToNs(stub::tick) / 1000000000ULL;
+    return 0;
+}
+
+Result timeToCalendarTimeWithMyRule(u64 timestamp, TimeCalendarTime* caltime, TimeCalendarAdditionalInfo* info)
+{
+    time_t local = (time_t)(timestamp + stub::utcOffset);
+    struct tm calendar;
+    gmtime_r(&local, &calendar);
+
+    caltime->year = calendar.tm_year + 1900;
+    caltime->month = calendar.tm_mon + 1;
+    caltime->day = calendar.tm_mday;
+    caltime->hour = calendar.tm_hour;
+    caltime->minute = calendar.tm_min;
+    caltime->second = calendar.tm_sec;
+    caltime->pad = 0;
+
+    if (info)
+    {
+        info->wday = calendar.tm_wday;
+        info->yday = calendar.tm_yday;
+        snprintf(info->timezoneName, sizeof(info->timezoneName), "UTC");
+        info->DST = 0;
+        info->offset = stub::utcOffset;
+    }
+    return 0;
+}
+
+Result setsysGetColorSetId(ColorSetId* out)
+{
+    stub::getColorSetCalls++;
+    if (R_FAILED(stub::getColorSetResult))
+        return stub::getColorSetResult;
+    *out = stub::colorSet;
+    return 0;
+}
+
+Result setsysSetColorSetId(ColorSetId id)
+{
+    stub::setColorSetCalls++;
+    if (R_FAILED(stub::setColorSetResult))
+        return stub::setColorSetResult;
+    stub::colorSet = id;
+    return 0;
+}
+
+Result lblSetCurrentBrightnessSetting(float brightness)
+{
+    stub::brightnessCalls++;
+    stub::brightness = brightness;
+    return 0;
+}
+
+Result lblGetAmbientLightSensorValue(bool* overLimit, float* lux)
+{
+    stub::ambientLightCalls++;
+    if (R_FAILED(stub::ambientLightResult))
+        return stub::ambientLightResult;
+    *overLimit = false;
+    *lux = stub::luxAt ? stub::luxAt(armTicksToNs(stub::tick)) : stub::lux;
+    return 0;
+}
+
+Result pmdmntGetApplicationProcessId(u64* pid)
+{
+    if (stub::applicationTitleId == 0)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+    *pid = 0x80;
+    return 0;
+}
+
+Result pminfoGetProgramId(u64* programId, u64 pid)
+{
+    (void)pid;
+    if (stub::applicationTitleId == 0)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+    *programId = stub::applicationTitleId;
+    return 0;
+}
+
+u32 crc32Calculate(const void* src, size_t size)
+{
+    const u8* bytes = (const u8*)src;
+    u32 crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+// Deterministic, so runs can be repeated
+u64 randomGet64(void)
+{
+    static u64 state = 0x9E3779B97F4A7C15ULL;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+void ueventCreate(UEvent* event, bool autoClear)
+{
+    event->signaled = false;
+    event->autoClear = autoClear;
+}
+
+void ueventSignal(UEvent* event)
+{
+    __atomic_store_n(&event->signaled, true, __ATOMIC_RELEASE);
+}
+
+void ueventClear(UEvent* event)
+{
+    __atomic_store_n(&event->signaled, false, __ATOMIC_RELEASE);
+}
+
+Waiter waiterForUEvent(UEvent* event)
+{
+    Waiter waiter;
+    waiter.event = event;
+    return waiter;
+}
+
+// Returns the first signaled event. There's nothing to block on for a single
+// host thread, so if none is signaled, the wait times out right away and the
+// tick moves forward by the timeout instead.
+Result waitObjects(s32* idx, const Waiter* objects, s32 count, u64 timeout)
+{
+    for (s32 i = 0; i < count; i++)
+    {
+        UEvent* event = objects[i].event;
+        if (!event || !__atomic_load_n(&event->signaled, __ATOMIC_ACQUIRE))
+            continue;
+
+        if (event->autoClear)
+            __atomic_store_n(&event->signaled, false, __ATOMIC_RELEASE);
+        *idx = i;
+        return 0;
+    }
+
+    if (timeout != UINT64_MAX)
+        stub::advance(timeout);
+    return KERNELRESULT(TimedOut);
+}
+
+Result waitSingle(Waiter object, u64 timeout)
+{
+    s32 idx;
+    return waitObjects(&idx, &object, 1, timeout);
+}
+
+}
@@ -0,0 +1,180 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Host stand-in for the parts of libnx the sysmodule uses, so its sources can be
+// built and tested on a PC. The system services are simulated by the state in the
+// stub namespace below, which the tests set up and inspect.
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef u32 Result;
+typedef u32 Handle;
+
+#define INVALID_HANDLE ((Handle)0)
+
+#define R_SUCCEEDED(res) ((res) == 0)
+#define R_FAILED(res) ((res) != 0)
+#define R_MODULE(res) ((res) & 0x1FF)
+#define R_DESCRIPTION(res) (((res) >> 9) & 0x1FFF)
+#define R_VALUE(res) ((res) & 0x3FFFFF)
+#define MAKERESULT(module, description) (((module) & 0x1FF) | ((description) & 0x1FFF) << 9)
+#define KERNELRESULT(description) MAKERESULT(Module_Kernel, KernelError_##description)
+
+enum { Module_Kernel = 1, Module_Libnx = 345 };
+enum { KernelError_TimedOut = 117 };
+enum
+{
+    LibnxError_InitFail_SM = 1,
+    LibnxError_InitFail_Time,
+    LibnxError_NotInitialized,
+    LibnxError_InitFail_FS,
+    LibnxError_BadInput,
+    LibnxError_NotFound,
+    LibnxError_IoError
+};
+enum { AppletType_None = -2 };
+
+typedef enum { ColorSetId_Light = 0, ColorSetId_Dark = 1 } ColorSetId;
+typedef enum { TimeType_UserSystemClock, TimeType_NetworkSystemClock, TimeType_LocalSystemClock, TimeType_Default = TimeType_UserSystemClock } TimeType;
+
+typedef struct
+{
+    u16 year;
+    u8 month;
+    u8 day;
+    u8 hour;
+    u8 minute;
+    u8 second;
+    u8 pad;
+} TimeCalendarTime;
+
+typedef struct
+{
+    u32 wday;
+    u32 yday;
+    char timezoneName[8];
+    u32 DST;
+    s32 offset;
+} TimeCalendarAdditionalInfo;
+
+typedef struct
+{
+    bool signaled;
+    bool autoClear;
+} UEvent;
+
+typedef struct
+{
+    UEvent* event;
+} Waiter;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+Result smInitialize(void);
+void smExit(void);
+Result fsInitialize(void);
+void fsExit(void);
+Result fsdevMountSdmc(void);
+int fsdevUnmountAll(void);
+Result timeInitialize(void);
+void timeExit(void);
+Result setInitialize(void);
+void setExit(void);
+Result setsysInitialize(void);
+void setsysExit(void);
+Result lblInitialize(void);
+void lblExit(void);
+Result pmdmntInitialize(void);
+void pmdmntExit(void);
+Result pminfoInitialize(void);
+void pminfoExit(void);
+
+void fatalThrow(Result res) __attribute__((noreturn));
+
+u64 armGetSystemTick(void);
+u64 armTicksToNs(u64 ticks);
+u64 armNsToTicks(u64 ns);
+Handle threadGetCurHandle(void);
+void svcSleepThread(s64 nano);
+
+Result timeGetCurrentTime(TimeType type, u64* timestamp);
+Result timeToCalendarTimeWithMyRule(u64 timestamp, TimeCalendarTime* caltime, TimeCalendarAdditionalInfo* info);
+
+Result setsysGetColorSetId(ColorSetId* out);
+Result setsysSetColorSetId(ColorSetId id);
+
+Result lblSetCurrentBrightnessSetting(float brightness);
+Result lblGetAmbientLightSensorValue(bool* overLimit, float* lux);
+
+Result pmdmntGetApplicationProcessId(u64* pid);
+Result pminfoGetProgramId(u64* programId, u64 pid);
+
+u32 crc32Calculate(const void* src, size_t size);
+u64 randomGet64(void);
+
+void ueventCreate(UEvent* event, bool autoClear);
+void ueventSignal(UEvent* event);
+void ueventClear(UEvent* event);
+Waiter waiterForUEvent(UEvent* event);
+Result waitObjects(s32* idx, const Waiter* objects, s32 count, u64 timeout);
+Result waitSingle(Waiter object, u64 timeout);
+
+#ifdef __cplusplus
+}
+
+#include <atomic>
+
+namespace stub
+{
+    // System tick. Only moves when a wait times out or a test advances it, so
+    // runs don't depend on the speed of the host.
+    extern std::atomic<u64> tick;
+
+    // Advances the tick by the given nanoseconds
+    void advance(u64 ns);
+
+    // Time service: POSIX time at tick 0, the UTC offset of the device's time
+    // zone, and the result of timeGetCurrentTime
+    extern u64 posixTimeBase;
+    extern s32 utcOffset;
+    extern Result timeResult;
+    extern u32 timeCalls;
+
+    // System settings
+    extern ColorSetId colorSet;
+    extern Result getColorSetResult;
+    extern Result setColorSetResult;
+    extern u32 getColorSetCalls;
+    extern u32 setColorSetCalls;
+
+    // Backlight and ambient light sensor
+    extern float brightness;
+    extern u32 brightnessCalls;
+    extern float lux;
+    // If set, the sensor reads this function of the time since boot (in ns) instead of lux
+    extern float (*luxAt)(u64 ns);
+    extern Result ambientLightResult;
+    extern u32 ambientLightCalls;
+
+    // Foreground application, 0 if there is none
+    extern u64 applicationTitleId;
+
+    // Restores all of the above to their defaults
+    void reset();
+}
+#endif
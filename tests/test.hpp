@@ -0,0 +1,46 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+#pragma once
+#include <chrono>
+#include <cstdio>
+
+// Checks a condition, and reports it with its location if it doesn't hold
+#define CHECK(cond) nxlightswitch_test::check((cond), #cond, __FILE__, __LINE__)
+
+namespace nxlightswitch_test
+{
+    inline int& failures()
+    {
+        static int count = 0;
+        return count;
+    }
+
+    inline bool check(bool passed, const char* cond, const char* file, int line)
+    {
+        if (!passed)
+        {
+            printf("%s:%d: check failed: %s\n", file, line, cond);
+            failures()++;
+        }
+        return passed;
+    }
+
+    // Prints the verdict, and returns the exit code for main
+    inline int result()
+    {
+        if (failures())
+            printf("FAILED (%d checks)\n", failures());
+        else
+            printf("passed\n");
+        return failures() ? 1 : 0;
+    }
+
+    // Wall clock time of the host in nanoseconds, for benchmarks
+    inline double now()
+    {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
@@ -0,0 +1,110 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Checks the perfect hash of TitleRules against a linear scan, and times loading
+// and looking up about as many rules as it takes
+
+#include "test.hpp"
+#include "titlerules.hpp"
+#include <vector>
+using namespace nxlightswitch;
+
+// A few under the cap, which leaves room for the duplicates
+#define RULE_COUNT 4000
+#define LOOKUP_ROUNDS 100
+
+// Splitmix64, so the title IDs are the same on every run
+static u64 NextRandom(u64& state)
+{
+    u64 z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// What Find should return: the last rule listed for the title
+static const TitleRule* LinearFind(const std::vector<TitleRule>& rules, u64 titleId)
+{
+    const TitleRule* found = NULL;
+    for (size_t i = 0; i < rules.size(); i++)
+    {
+        if (rules[i].titleId == titleId)
+            found = &rules[i];
+    }
+    return found;
+}
+
+int main()
+{
+    // Application title IDs, with every 100th listed twice with the other theme
+    u64 random = 1;
+    std::vector<TitleRule> rules;
+    for (int i = 0; i < RULE_COUNT; i++)
+    {
+        TitleRule rule;
+        rule.titleId = 0x0100000000000000ULL | (NextRandom(random) & 0x00FFFFFFFFFFF000ULL);
+        rule.theme = (i % 3) ? ColorSetId_Dark : ColorSetId_Light;
+        rules.push_back(rule);
+    }
+    for (int i = 0; i < RULE_COUNT; i += 100)
+    {
+        TitleRule rule = rules[i];
+        rule.theme = rule.theme == ColorSetId_Dark ? ColorSetId_Light : ColorSetId_Dark;
+        rules.push_back(rule);
+    }
+
+    FILE* file = fopen(TITLE_RULES_PATH, "w");
+    CHECK(file != NULL);
+    if (!file)
+        return nxlightswitch_test::result();
+    fprintf(file, "[TitleRules]\n");
+    for (size_t i = 0; i < rules.size(); i++)
+        fprintf(file, "%016llX = %s\n", (unsigned long long)rules[i].titleId, rules[i].theme == ColorSetId_Dark ? "dark" : "light");
+    fclose(file);
+
+    TitleRules titleRules;
+    double start = nxlightswitch_test::now();
+    CHECK(titleRules.Load(TITLE_RULES_PATH));
+    double loadTime = nxlightswitch_test::now() - start;
+    CHECK(titleRules.Count() == RULE_COUNT);
+
+    // Every listed title, and as many which aren't, must match the linear scan
+    std::vector<u64> titleIds;
+    for (size_t i = 0; i < rules.size(); i++)
+        titleIds.push_back(rules[i].titleId);
+    for (int i = 0; i < RULE_COUNT; i++)
+        titleIds.push_back(NextRandom(random));
+
+    int mismatches = 0;
+    for (size_t i = 0; i < titleIds.size(); i++)
+    {
+        const TitleRule* expected = LinearFind(rules, titleIds[i]);
+        ColorSetId theme;
+        bool found = titleRules.Find(titleIds[i], &theme);
+        if ((expected != NULL) != found || (found && theme != expected->theme))
+            mismatches++;
+    }
+    CHECK(mismatches == 0);
+
+    // Time the lookups of both
+    u32 hits = 0;
+    ColorSetId theme;
+    start = nxlightswitch_test::now();
+    for (int round = 0; round < LOOKUP_ROUNDS; round++)
+    {
+        for (size_t i = 0; i < titleIds.size(); i++)
+            hits += titleRules.Find(titleIds[i], &theme);
+    }
+    double hashTime = (nxlightswitch_test::now() - start) / (LOOKUP_ROUNDS * titleIds.size());
+
+    start = nxlightswitch_test::now();
+    for (size_t i = 0; i < titleIds.size(); i++)
+        hits += LinearFind(rules, titleIds[i]) != NULL;
+    double linearTime = (nxlightswitch_test::now() - start) / titleIds.size();
+
+    printf("%d rules: load %.1f ms, lookup %.1f ns (linear scan %.0f ns), %u hits\n",
+        RULE_COUNT, loadTime / 1e6, hashTime, linearTime, hits);
+    return nxlightswitch_test::result();
+}
@@ -0,0 +1,245 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Checks that trace dumps are valid JSON in Chrome's trace event format, with
+// every span closed, also when the buffer is empty or wrapped around, that they
+// keep the latest events, and that logging is traced
+
+#include "test.hpp"
+#include "tracer.hpp"
+#include "logger.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace nxlightswitch;
+
+// Minimal JSON syntax check, enough for what the tracer writes
+class JsonChecker
+{
+public:
+    JsonChecker(const std::string& text) : text(text), pos(0) {}
+
+    bool Check()
+    {
+        return Value() && (SkipSpace(), pos == text.size());
+    }
+
+private:
+    void SkipSpace()
+    {
+        while (pos < text.size() && strchr(" \t\r\n", text[pos]))
+            pos++;
+    }
+
+    bool Accept(char c)
+    {
+        SkipSpace();
+        if (pos < text.size() && text[pos] == c)
+        {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    bool String()
+    {
+        if (!Accept('"'))
+            return false;
+        while (pos < text.size() && text[pos] != '"')
+        {
+            if ((unsigned char)text[pos] < 0x20)
+                return false;
+            if (text[pos] == '\\')
+                pos++;
+            pos++;
+        }
+        return pos++ < text.size();
+    }
+
+    bool Number()
+    {
+        SkipSpace();
+        size_t start = pos;
+        if (pos < text.size() && text[pos] == '-')
+            pos++;
+        while (pos < text.size() && strchr("0123456789.eE+-", text[pos]))
+            pos++;
+        return pos > start;
+    }
+
+    bool Value()
+    {
+        SkipSpace();
+        if (pos >= text.size())
+            return false;
+
+        if (Accept('{'))
+        {
+            if (Accept('}'))
+                return true;
+            do
+            {
+                if (!String() || !Accept(':') || !Value())
+                    return false;
+            } while (Accept(','));
+            return Accept('}');
+        }
+
+        if (Accept('['))
+        {
+            if (Accept(']'))
+                return true;
+            do
+            {
+                if (!Value())
+                    return false;
+            } while (Accept(','));
+            return Accept(']');
+        }
+
+        if (text[pos] == '"')
+            return String();
+        if (text.compare(pos, 4, "true") == 0 || text.compare(pos, 4, "null") == 0)
+            return pos += 4, true;
+        if (text.compare(pos, 5, "false") == 0)
+            return pos += 5, true;
+        return Number();
+    }
+
+    const std::string& text;
+    size_t pos;
+};
+
+static std::string ReadTrace()
+{
+    std::string text;
+    FILE* file = fopen(TRACE_FILE_PATH, "r");
+    if (!file)
+        return text;
+    char chunk[512];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        text.append(chunk, read);
+    fclose(file);
+    return text;
+}
+
+// Counts how often a substring occurs
+static int Count(const std::string& text, const char* needle)
+{
+    int count = 0;
+    for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1))
+        count++;
+    return count;
+}
+
+// Checks the trace's syntax, that spans are properly nested and timestamps don't go back
+static void CheckTrace(int expectedEvents, int expectedDropped)
+{
+    std::string text = ReadTrace();
+    CHECK(!text.empty());
+    CHECK(JsonChecker(text).Check());
+    CHECK(Count(text, "\"ph\":") == expectedEvents);
+
+    char dropped[64];
+    snprintf(dropped, sizeof(dropped), "\"droppedEvents\":%d}", expectedDropped);
+    CHECK(Count(text, dropped) == 1);
+
+    int depth = 0;
+    unsigned long long lastTs = 0;
+    for (size_t pos = text.find("\"ph\":\""); pos != std::string::npos; pos = text.find("\"ph\":\"", pos + 1))
+    {
+        char phase = text[pos + 6];
+        CHECK(phase == 'B' || phase == 'E');
+        depth += phase == 'B' ? 1 : -1;
+        CHECK(depth >= 0);
+
+        unsigned long long ts = strtoull(text.c_str() + text.find("\"ts\":", pos) + 5, NULL, 10);
+        CHECK(ts >= lastTs);
+        lastTs = ts;
+    }
+}
+
+int main()
+{
+    Tracer* tracer = Tracer::get();
+    tracer->setEnabled(true);
+
+    // Nothing recorded yet
+    CHECK(tracer->dump());
+    CheckTrace(0, 0);
+
+    // Nested spans
+    for (int i = 0; i < 10; i++)
+    {
+        TRACE_SCOPE("Outer");
+        stub::advance(1000000);
+        {
+            TRACE_SCOPE("Inner");
+            stub::advance(500000);
+        }
+    }
+    CHECK(tracer->dump());
+    CheckTrace(40, 0);
+
+    // Wrapping around keeps the latest events. The oldest one kept is the end of
+    // an inner span, after it the end of an outer one, and both are left out.
+    for (int i = 0; i < TRACE_BUFFER_SIZE / 4 + 10; i++)
+    {
+        TRACE_SCOPE("Outer");
+        stub::advance(1000);
+        {
+            TRACE_SCOPE("Inner");
+            stub::advance(1000);
+        }
+    }
+    {
+        TRACE_SCOPE("Latest");
+    }
+    CHECK(tracer->dump());
+    CheckTrace(TRACE_BUFFER_SIZE - 2, 44);
+    std::string text = ReadTrace();
+    CHECK(text.find("\"name\":\"Outer\",\"ph\":\"B\"") < text.find("\"name\":\"Inner\",\"ph\":\"E\""));
+    CHECK(Count(text, "\"name\":\"Latest\"") == 2);
+
+    // Spans from several threads at once all end up in the ring or dropped
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.push_back(std::thread([]()
+        {
+            for (int i = 0; i < TRACE_BUFFER_SIZE; i++)
+                TraceScope scope("Thread");
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    CHECK(tracer->dump());
+    text = ReadTrace();
+    CHECK(JsonChecker(text).Check());
+    int written = Count(text, "\"ph\":");
+    int dropped = atoi(text.c_str() + text.find("\"droppedEvents\":") + 16);
+    CHECK(written <= TRACE_BUFFER_SIZE && written > TRACE_BUFFER_SIZE - 8);
+    CHECK(written + dropped == 4 * 2 * TRACE_BUFFER_SIZE);
+
+    // Logging is traced
+    LOG("Traced line %d", 1);
+    CHECK(tracer->dump());
+    CheckTrace(2, 0);
+    CHECK(Count(ReadTrace(), "\"name\":\"Logger::log\"") == 2);
+
+    // Disabled tracing records nothing
+    tracer->setEnabled(false);
+    {
+        TRACE_SCOPE("Disabled");
+    }
+    CHECK(tracer->dump());
+    CheckTrace(0, 0);
+
+    return nxlightswitch_test::result();
+}
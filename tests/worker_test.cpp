@@ -0,0 +1,205 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Runs the Worker against the libnx stub through whole days, checking the theme
+// it leaves the console in
+
+#include "test.hpp"
+#include "logger.hpp"
+#include "worker.hpp"
+#include <string>
+using namespace nxlightswitch;
+
+#define SECONDS_PER_HOUR 3600ULL
+
+static void WriteConfig(const char* content)
+{
+    FILE* file = fopen(CONFIG_PATH, "w");
+    fputs(content, file);
+    fclose(file);
+}
+
+// Starts the console at the given local time on 1 January 2024, with a fresh journal
+static void Boot(u32 hour, u32 minute)
+{
+    stub::reset();
+    stub::posixTimeBase += hour * SECONDS_PER_HOUR + minute * 60;
+    remove(STATE_JOURNAL_PATH);
+}
+
+// Runs the worker like its task does, until the given seconds have passed
+static void Run(Worker& worker, Platform& platform, u64 seconds)
+{
+    u64 end = stub::tick + armNsToTicks(seconds * 1000000000ULL);
+    while (stub::tick < end)
+    {
+        worker.DoWork();
+        Logger::get()->flush();
+        u64 timeout = std::min(worker.GetWaitTimeout(WORKER_UPDATE_INTERVAL), armTicksToNs(end - stub::tick));
+        s32 index;
+        platform.Wait(NULL, 0, timeout, &index);
+    }
+}
+
+// A theme picked by hand stays until the next light/dark time, even when
+// something else asks for a check in between
+static void TestManualOverride()
+{
+    WriteConfig("[NXLightSwitch]\nLightTime = 07:00\nDarkTime = 19:00\n");
+    Boot(8, 0);
+
+    SwitchPlatform platform;
+    PmForegroundTitleSource titleSource;
+    Worker worker(&platform, &titleSource);
+    Run(worker, platform, 60);
+    CHECK(stub::colorSet == ColorSetId_Light);
+
+    // The user picks dark, then starts a game without a rule
+    stub::colorSet = ColorSetId_Dark;
+    Run(worker, platform, 60);
+    stub::applicationTitleId = 0x0100000000010000ULL;
+    Run(worker, platform, 60);
+    CHECK(stub::colorSet == ColorSetId_Dark);
+
+    // Still theirs after a restart
+    {
+        Worker restarted(&platform, &titleSource);
+        Run(restarted, platform, 60);
+        CHECK(stub::colorSet == ColorSetId_Dark);
+    }
+
+    // Light again at the next light time
+    u32 setCalls = stub::setColorSetCalls;
+    Run(worker, platform, 24 * SECONDS_PER_HOUR);
+    CHECK(stub::colorSet == ColorSetId_Light);
+    CHECK(stub::setColorSetCalls == setCalls + 1);
+
+    // Picking the scheduled theme by hand ends the override, so dark comes at dark time
+    stub::colorSet = ColorSetId_Dark;
+    stub::applicationTitleId = 0;
+    Run(worker, platform, 60);
+    stub::colorSet = ColorSetId_Light;
+    stub::applicationTitleId = 0x0100000000010000ULL;
+    Run(worker, platform, 12 * SECONDS_PER_HOUR);
+    CHECK(stub::colorSet == ColorSetId_Dark);
+}
+
+static std::string ReadLog()
+{
+    std::string text;
+    FILE* file = fopen(LOG_FILE_PATH, "r");
+    if (!file)
+        return text;
+    char chunk[512];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        text.append(chunk, read);
+    fclose(file);
+    return text;
+}
+
+// A failing setsys is backed off from instead of being called every tick, and
+// the theme is applied once it works again
+static void TestFailingService()
+{
+    WriteConfig("[NXLightSwitch]\nLightTime = 07:00\nDarkTime = 19:00\n");
+    Boot(20, 0);
+    stub::getColorSetResult = MAKERESULT(Module_Libnx, LibnxError_IoError);
+    Logger::get()->clearLogFile();
+
+    SwitchPlatform platform;
+    PmForegroundTitleSource titleSource;
+    Worker worker(&platform, &titleSource);
+    Run(worker, platform, SECONDS_PER_HOUR);
+    CHECK(stub::colorSet == ColorSetId_Light);
+    CHECK(stub::getColorSetCalls >= SERVICE_BREAKER_THRESHOLD && stub::getColorSetCalls <= 12);
+
+    // The failures below the threshold are logged where the call was made
+    std::string log = ReadLog();
+    CHECK(log.find("worker.cpp:") != std::string::npos);
+    CHECK(log.find("servicebreaker.cpp") == std::string::npos);
+
+    // And the breaker's own lines about suspending and retrying it are errors too
+    CHECK(log.find(": ERROR: setsysGetColorSetId failed 3 times in a row") != std::string::npos);
+    CHECK(log.find(": ERROR: setsysGetColorSetId still failing") != std::string::npos);
+    for (size_t start = 0, end; (end = log.find('\n', start)) != std::string::npos; start = end + 1)
+    {
+        std::string line = log.substr(start, end - start);
+        if (line.find("setsysGetColorSetId") != std::string::npos)
+            CHECK(line.compare(21, 5, "ERROR") == 0);
+    }
+
+    // The longest backoff so far has run out within the next hour
+    stub::getColorSetResult = 0;
+    Run(worker, platform, SECONDS_PER_HOUR);
+    CHECK(stub::colorSet == ColorSetId_Dark);
+}
+
+// Restoring the state after a restart goes through the breaker too, and a theme
+// picked by hand before the restart is still noticed once setsys works again
+static void TestFailingServiceOnRestore()
+{
+    WriteConfig("[NXLightSwitch]\nLightTime = 07:00\nDarkTime = 19:00\n");
+    Boot(8, 0);
+
+    SwitchPlatform platform;
+    PmForegroundTitleSource titleSource;
+    {
+        Worker worker(&platform, &titleSource);
+        Run(worker, platform, 60);
+        CHECK(stub::colorSet == ColorSetId_Light);
+    }
+
+    stub::colorSet = ColorSetId_Dark;
+    stub::getColorSetResult = MAKERESULT(Module_Libnx, LibnxError_IoError);
+    stub::getColorSetCalls = 0;
+    Worker restarted(&platform, &titleSource);
+    Run(restarted, platform, 10 * 60);
+    CHECK(stub::getColorSetCalls >= SERVICE_BREAKER_THRESHOLD && stub::getColorSetCalls <= 8);
+
+    stub::getColorSetResult = 0;
+    Run(restarted, platform, SECONDS_PER_HOUR);
+    CHECK(stub::colorSet == ColorSetId_Dark);
+    CHECK(stub::setColorSetCalls == 0);
+}
+
+// A config longer than the old 4 KiB limit is read, one over CONFIG_MAX_SIZE
+// is rejected as a whole and logged as such
+static void TestLargeConfig()
+{
+    std::string config = "[NXLightSwitch]\n";
+    while (config.size() < 6 * 1024)
+        config += "; A long comment explaining the settings below, as some people like to keep\n";
+    config += "LightTime = 07:00\nDarkTime = 19:00\n";
+    WriteConfig(config.c_str());
+    Boot(20, 0);
+    Logger::get()->clearLogFile();
+
+    SwitchPlatform platform;
+    PmForegroundTitleSource titleSource;
+    {
+        Worker worker(&platform, &titleSource);
+        Run(worker, platform, 60);
+        CHECK(stub::colorSet == ColorSetId_Dark);
+    }
+
+    while (config.size() <= CONFIG_MAX_SIZE)
+        config.insert(16, "; More of it\n");
+    WriteConfig(config.c_str());
+    stub::colorSet = ColorSetId_Light;
+    Worker worker(&platform, &titleSource);
+    Run(worker, platform, 60);
+    CHECK(stub::colorSet == ColorSetId_Light);
+    CHECK(ReadLog().find("Config file is larger than") != std::string::npos);
+}
+
+int main()
+{
+    TestManualOverride();
+    TestFailingService();
+    TestFailingServiceOnRestore();
+    TestLargeConfig();
+    return nxlightswitch_test::result();
+}
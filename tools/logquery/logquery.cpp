@@ -0,0 +1,466 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+
+    logquery: answers time range queries over NXLightSwitch.txt logs copied off
+    the SD card. The log is memory-mapped and a sparse index (one entry per block
+    of the log, holding the block's time range and per-type line counts) is cached
+    next to it as <log>.idx, so queries only ever touch the blocks they need.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Size of the log blocks the index has one entry for
+#define INDEX_BLOCK_SIZE (64 * 1024)
+
+// Identifies index files, bump the version whenever the layout changes
+#define INDEX_MAGIC 0x31584449534C584Eull // "NXLSIDX1"
+#define INDEX_VERSION 2
+
+// How many bytes of the log start the index remembers to notice a rewritten log
+#define INDEX_HEAD_SIZE 4096
+
+// Kinds of log lines, told apart by their message
+enum EventType
+{
+    EventType_Theme,
+    EventType_Brightness,
+    EventType_Error,
+    EventType_Info,
+    EventType_Count
+};
+
+static const char* EventTypeNames[EventType_Count] = { "theme", "brightness", "error", "info" };
+
+// Index entry for one block of the log. A block starts at a line start and holds
+// every line starting within INDEX_BLOCK_SIZE bytes of it.
+struct IndexBlock
+{
+    uint64_t offset;
+    int64_t minTime;
+    int64_t maxTime;
+    uint32_t counts[EventType_Count];
+};
+
+struct IndexHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t blockSize;
+    uint64_t logSize;
+    uint64_t headHash;
+    uint64_t blockCount;
+};
+
+// Mapped log file
+struct LogFile
+{
+    const char* data;
+    size_t size;
+};
+
+// A parsed log line
+struct LogLine
+{
+    int64_t time;
+    const char* message;
+    const char* end;
+};
+
+// Days since the epoch of a Gregorian date (Howard Hinnant's days_from_civil)
+static int64_t DaysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return (int64_t)era * 146097 + dayOfEra - 719468;
+}
+
+// Parses fixed-width digits, returns -1 if any of them isn't one
+static int ParseDigits(const char* s, int count)
+{
+    int value = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (s[i] < '0' || s[i] > '9')
+            return -1;
+        value = value * 10 + (s[i] - '0');
+    }
+    return value;
+}
+
+// Parses a line written by Logger::log ("DD-MM-YYYY HH:MM:SS: message").
+// Returns false for lines without a timestamp.
+static bool ParseLine(const char* line, const char* end, LogLine* out)
+{
+    if (end - line < 21 || line[2] != '-' || line[5] != '-' || line[10] != ' '
+        || line[13] != ':' || line[16] != ':' || line[19] != ':')
+        return false;
+
+    int day = ParseDigits(line, 2);
+    int month = ParseDigits(line + 3, 2);
+    int year = ParseDigits(line + 6, 4);
+    int hour = ParseDigits(line + 11, 2);
+    int minute = ParseDigits(line + 14, 2);
+    int second = ParseDigits(line + 17, 2);
+    if (day < 0 || month < 0 || year < 0 || hour < 0 || minute < 0 || second < 0)
+        return false;
+
+    out->time = DaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    out->message = line + 20 < end && line[20] == ' ' ? line + 21 : line + 20;
+    out->end = end;
+    return true;
+}
+
+// Tells the type of a log line by its message
+static EventType ClassifyLine(const LogLine& line)
+{
+    size_t length = line.end - line.message;
+    if (length >= 5 && memcmp(line.message, "ERROR", 5) == 0)
+        return EventType_Error;
+    if (length >= 16 && memcmp(line.message, "Changed theme to", 16) == 0)
+        return EventType_Theme;
+    if (length >= 21 && memcmp(line.message, "Changed brightness to", 21) == 0)
+        return EventType_Brightness;
+    return EventType_Info;
+}
+
+// Parses "YYYY-MM-DD[ HH:MM[:SS]]" into seconds since the epoch
+static bool ParseQueryTime(const char* str, int64_t* out)
+{
+    int year, month, day, hour = 0, minute = 0, second = 0;
+    int fields = sscanf(str, "%d-%d-%d %d:%d:%d", &year, &month, &day, &hour, &minute, &second);
+    if (fields != 3 && fields < 5)
+        return false;
+
+    *out = DaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+// Formats seconds since the epoch as "YYYY-MM-DD"
+static std::string FormatDay(int64_t time)
+{
+    time_t t = (time_t)time;
+    struct tm calendar;
+    gmtime_r(&t, &calendar);
+
+    char buffer[16];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d", &calendar);
+    return buffer;
+}
+
+// FNV-1a over the start of the log, to notice when it was cleared and rewritten
+static uint64_t HashHead(const LogFile& log)
+{
+    uint64_t hash = 14695981039346656037ull;
+    size_t length = log.size < INDEX_HEAD_SIZE ? log.size : INDEX_HEAD_SIZE;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ (uint8_t)log.data[i]) * 1099511628211ull;
+    return hash;
+}
+
+// Indexes the log from the given offset (a line start) to its end
+static void IndexFrom(const LogFile& log, uint64_t offset, std::vector<IndexBlock>& blocks)
+{
+    const char* end = log.data + log.size;
+    const char* line = log.data + offset;
+
+    while (line < end)
+    {
+        IndexBlock block;
+        memset(&block, 0, sizeof(block));
+        block.offset = line - log.data;
+        block.minTime = INT64_MAX;
+        block.maxTime = INT64_MIN;
+
+        const char* blockEnd = line + INDEX_BLOCK_SIZE;
+        while (line < end && line < blockEnd)
+        {
+            const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+            if (!lineEnd)
+                lineEnd = end;
+
+            LogLine parsed;
+            if (ParseLine(line, lineEnd, &parsed))
+            {
+                if (parsed.time < block.minTime)
+                    block.minTime = parsed.time;
+                if (parsed.time > block.maxTime)
+                    block.maxTime = parsed.time;
+                block.counts[ClassifyLine(parsed)]++;
+            }
+
+            line = lineEnd + 1;
+        }
+
+        blocks.push_back(block);
+    }
+}
+
+// Loads the cached index if it still matches the log, extends it if the log only
+// grew since, or builds it from scratch. Rewrites the cache when it changed.
+static std::vector<IndexBlock> LoadIndex(const LogFile& log, const std::string& indexPath, bool rebuild)
+{
+    std::vector<IndexBlock> blocks;
+    uint64_t headHash = HashHead(log);
+
+    IndexHeader header;
+    FILE* indexFile = rebuild ? NULL : fopen(indexPath.c_str(), "rb");
+    if (indexFile)
+    {
+        // The log can only have been appended to if the start is unchanged and it didn't shrink
+        if (fread(&header, sizeof(header), 1, indexFile) == 1 && header.magic == INDEX_MAGIC
+            && header.version == INDEX_VERSION && header.blockSize == INDEX_BLOCK_SIZE
+            && header.logSize <= log.size && header.logSize >= INDEX_HEAD_SIZE && header.headHash == headHash)
+        {
+            blocks.resize(header.blockCount);
+            if (header.blockCount && fread(&blocks[0], sizeof(IndexBlock), header.blockCount, indexFile) != header.blockCount)
+                blocks.clear();
+        }
+        fclose(indexFile);
+
+        if (!blocks.empty() && header.logSize == log.size)
+            return blocks;
+    }
+
+    // Reindex from the start of the last block, which may have been cut short
+    uint64_t offset = 0;
+    if (!blocks.empty())
+    {
+        offset = blocks.back().offset;
+        blocks.pop_back();
+    }
+    IndexFrom(log, offset, blocks);
+
+    header.magic = INDEX_MAGIC;
+    header.version = INDEX_VERSION;
+    header.blockSize = INDEX_BLOCK_SIZE;
+    header.logSize = log.size;
+    header.headHash = headHash;
+    header.blockCount = blocks.size();
+
+    indexFile = fopen(indexPath.c_str(), "wb");
+    if (indexFile)
+    {
+        fwrite(&header, sizeof(header), 1, indexFile);
+        if (!blocks.empty())
+            fwrite(&blocks[0], sizeof(IndexBlock), blocks.size(), indexFile);
+        fclose(indexFile);
+    }
+    else
+    {
+        fprintf(stderr, "Warning: could not write index %s\n", indexPath.c_str());
+    }
+
+    return blocks;
+}
+
+// Calls func for every timestamped line of the given block
+template <typename Func>
+static void ForEachLine(const LogFile& log, const std::vector<IndexBlock>& blocks, size_t block, Func func)
+{
+    const char* line = log.data + blocks[block].offset;
+    const char* end = block + 1 < blocks.size() ? log.data + blocks[block + 1].offset : log.data + log.size;
+
+    while (line < end)
+    {
+        const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+        if (!lineEnd)
+            lineEnd = end;
+
+        LogLine parsed;
+        if (ParseLine(line, lineEnd, &parsed))
+            func(line, parsed);
+
+        line = lineEnd + 1;
+    }
+}
+
+static void PrintUsage(const char* program)
+{
+    fprintf(stderr,
+        "Usage: %s [options] <NXLightSwitch.txt>\n"
+        "  --from \"YYYY-MM-DD[ HH:MM[:SS]]\"  only lines at or after this time\n"
+        "  --to \"YYYY-MM-DD[ HH:MM[:SS]]\"    only lines at or before this time\n"
+        "  --type <type>                     only lines of this type (theme, brightness, error, info)\n"
+        "  --count                           print the number of matching lines instead of the lines\n"
+        "  --stats                           print per-day statistics\n"
+        "  --reindex                         rebuild the cached index\n",
+        program);
+}
+
+int main(int argc, char* argv[])
+{
+    int64_t from = INT64_MIN;
+    int64_t to = INT64_MAX;
+    int type = -1;
+    bool countOnly = false;
+    bool stats = false;
+    bool rebuild = false;
+    const char* logPath = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--from") && i + 1 < argc)
+        {
+            if (!ParseQueryTime(argv[++i], &from))
+            {
+                fprintf(stderr, "Invalid time: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--to") && i + 1 < argc)
+        {
+            if (!ParseQueryTime(argv[++i], &to))
+            {
+                fprintf(stderr, "Invalid time: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--type") && i + 1 < argc)
+        {
+            i++;
+            for (int t = 0; t < EventType_Count; t++)
+            {
+                if (!strcmp(argv[i], EventTypeNames[t]))
+                    type = t;
+            }
+            if (type < 0)
+            {
+                fprintf(stderr, "Unknown type: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--count"))
+            countOnly = true;
+        else if (!strcmp(argv[i], "--stats"))
+            stats = true;
+        else if (!strcmp(argv[i], "--reindex"))
+            rebuild = true;
+        else if (argv[i][0] != '-' && !logPath)
+            logPath = argv[i];
+        else
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!logPath)
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    // Map the whole log, the OS pages in only what the query touches
+    int fd = open(logPath, O_RDONLY);
+    if (fd < 0)
+    {
+        perror(logPath);
+        return 1;
+    }
+
+    struct stat status;
+    fstat(fd, &status);
+
+    LogFile log;
+    log.size = (size_t)status.st_size;
+    log.data = "";
+    if (log.size > 0)
+    {
+        void* mapping = mmap(NULL, log.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            perror("mmap");
+            return 1;
+        }
+        log.data = (const char*)mapping;
+    }
+    close(fd);
+
+    std::vector<IndexBlock> blocks = LoadIndex(log, std::string(logPath) + ".idx", rebuild);
+
+    if (stats)
+    {
+        // Per-day counts. Blocks within a single day come straight from the index.
+        std::map<int64_t, uint64_t[EventType_Count]> days;
+        uint64_t totals[EventType_Count] = {};
+        for (size_t b = 0; b < blocks.size(); b++)
+        {
+            const IndexBlock& block = blocks[b];
+            if (block.minTime > block.maxTime || block.maxTime < from || block.minTime > to)
+                continue;
+
+            if (block.minTime >= from && block.maxTime <= to && block.minTime / 86400 == block.maxTime / 86400)
+            {
+                uint64_t* day = days[block.minTime / 86400];
+                for (int t = 0; t < EventType_Count; t++)
+                {
+                    day[t] += block.counts[t];
+                    totals[t] += block.counts[t];
+                }
+                continue;
+            }
+
+            ForEachLine(log, blocks, b, [&](const char*, const LogLine& line) {
+                if (line.time < from || line.time > to)
+                    return;
+                EventType t = ClassifyLine(line);
+                days[line.time / 86400][t]++;
+                totals[t]++;
+            });
+        }
+
+        printf("%-10s %8s %10s %8s %10s\n", "day", "theme", "brightness", "error", "info");
+        for (std::map<int64_t, uint64_t[EventType_Count]>::iterator it = days.begin(); it != days.end(); ++it)
+        {
+            printf("%-10s %8llu %10llu %8llu %10llu\n", FormatDay(it->first * 86400).c_str(),
+                (unsigned long long)it->second[EventType_Theme], (unsigned long long)it->second[EventType_Brightness],
+                (unsigned long long)it->second[EventType_Error], (unsigned long long)it->second[EventType_Info]);
+        }
+        printf("%-10s %8llu %10llu %8llu %10llu\n", "total",
+            (unsigned long long)totals[EventType_Theme], (unsigned long long)totals[EventType_Brightness],
+            (unsigned long long)totals[EventType_Error], (unsigned long long)totals[EventType_Info]);
+        return 0;
+    }
+
+    // Only visit blocks whose time range overlaps the query and that hold the wanted type
+    uint64_t matches = 0;
+    for (size_t b = 0; b < blocks.size(); b++)
+    {
+        const IndexBlock& block = blocks[b];
+        if (block.minTime > block.maxTime || block.maxTime < from || block.minTime > to)
+            continue;
+        if (type >= 0 && block.counts[type] == 0)
+            continue;
+
+        ForEachLine(log, blocks, b, [&](const char* start, const LogLine& line) {
+            if (line.time < from || line.time > to)
+                return;
+            if (type >= 0 && ClassifyLine(line) != type)
+                return;
+
+            matches++;
+            if (!countOnly)
+                fwrite(start, 1, line.end - start + (line.end < log.data + log.size), stdout);
+        });
+    }
+
+    if (countOnly)
+        printf("%llu\n", (unsigned long long)matches);
+
+    return 0;
+}
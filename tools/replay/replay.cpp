@@ -0,0 +1,80 @@
+/*
+    NXLightSwitch for Nintendo Switch
+    Made with love by Jonathan Verbeek (jverbeek.de)
+*/
+
+// Replays the inputs recorded with RecordInputs = true through the module's
+// tasks, without waiting, and reports how its decisions compare to the recording
+//
+//   replay NXLightSwitch.inputs.bin
+//
+// The title rules and exceptions are read from sdmc:/config/NXLightSwitch/ below
+// the current directory, so copy those of the console there to replay with them.
+
+#include <chrono>
+#include <cstdio>
+#include "executor.hpp"
+#include "inputtrace.hpp"
+#include "logger.hpp"
+#include "tasks.hpp"
+#include "worker.hpp"
+using namespace nxlightswitch;
+
+// Counts the executor's rounds and the time they cover
+class CountingReplayPlatform : public ReplayPlatform
+{
+public:
+    CountingReplayPlatform() : tickCount(0), firstTick(0), lastTick(0) {}
+
+    // The executor reads the tick once per round, so this counts its wakeups
+    // (and the rare reads of an open breaker)
+    virtual u64 GetTick()
+    {
+        u64 tick = ReplayPlatform::GetTick();
+        if (tickCount++ == 0)
+            firstTick = tick;
+        lastTick = tick;
+        return tick;
+    }
+
+    u32 tickCount;
+    u64 firstTick;
+    u64 lastTick;
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s NXLightSwitch.inputs.bin\n", argv[0]);
+        return 2;
+    }
+
+    static CountingReplayPlatform platform;
+    if (!platform.Load(argv[1]))
+    {
+        fprintf(stderr, "Could not load %s, or it isn't a trace of this version\n", argv[1]);
+        return 2;
+    }
+
+    // Set up like main.cpp, with the replay standing in for the system
+    Worker* worker = new Worker(&platform, &platform);
+    static Executor executor(&platform);
+    static ModuleTasks tasks(worker);
+    tasks.AddTo(&executor);
+    platform.StopAtEnd(&executor);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    executor.Run();
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    Logger::get()->flush();
+
+    double hours = armTicksToNs(platform.lastTick - platform.firstTick) / 3.6e12;
+    printf("Replayed %.1f hours of inputs in %d wakeups\n", hours, (int)platform.tickCount);
+    printf("Decisions:  %d\n", (int)platform.GetDecisionCount());
+    printf("Mismatches: %d\n", (int)platform.GetMismatchCount());
+    printf("Finished:   %s\n", platform.IsFinished() ? "yes" : "no");
+    printf("Cost:       %.0f ns per wakeup\n", platform.tickCount ? elapsed / platform.tickCount : 0.0);
+
+    return platform.GetMismatchCount() == 0 && platform.IsFinished() ? 0 : 1;
+}